@@ -16,6 +16,9 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifndef DCF77_CPP
+#define DCF77_CPP
+
 #include "dcf77.hpp"
 
 namespace dcf77 {
@@ -24,41 +27,248 @@ namespace dcf77 {
  * Class "debounce"                                                           *
  ******************************************************************************/
 
-static constexpr uint8_t FIXED_POINT_LOG2_BASE = 7;
-static constexpr uint8_t FIXED_POINT_BASE = (1 << FIXED_POINT_LOG2_BASE);
-static constexpr uint8_t FLT_F1 = FIXED_POINT_BASE * 0.97;
-static constexpr uint8_t FLT_F2 = FIXED_POINT_BASE - FLT_F1;
+template <typename T>
+static constexpr uint8_t FIXED_POINT_LOG2_BASE =
+    debounce_traits<T>::LOG2_BASE;
+template <typename T>
+static constexpr T FIXED_POINT_BASE = T(1) << FIXED_POINT_LOG2_BASE<T>;
+template <typename T>
+static constexpr T FLT_F1 = FIXED_POINT_BASE<T> * 0.97;
+template <typename T>
+static constexpr T FLT_F2 = FIXED_POINT_BASE<T> - FLT_F1<T>;
 
-static constexpr uint8_t filter(bool ctrl, uint8_t x)
+template <typename T>
+static constexpr T filter(T level, T x)
 {
-	return (uint16_t(x) * uint16_t(FLT_F1) +
-	        (ctrl ? uint16_t(FLT_F2) << FIXED_POINT_LOG2_BASE : 0)) >>
-	       FIXED_POINT_LOG2_BASE;
+	using wide = typename debounce_traits<T>::wide;
+	return (wide(x) * wide(FLT_F1<T>) + wide(FLT_F2<T>) * level) >>
+	       FIXED_POINT_LOG2_BASE<T>;
 }
 
-static constexpr uint8_t filter_convergence(bool ctrl,
-                                            uint8_t x = FIXED_POINT_BASE / 2)
+template <typename T>
+static constexpr T filter_convergence(T level)
 {
-	return filter(ctrl, x) == x ? x : filter_convergence(ctrl, filter(ctrl, x));
+	T x = FIXED_POINT_BASE<T> / 2;
+	while (filter(level, x) != x) {
+		x = filter(level, x);
+	}
+	return x;
 }
 
-static constexpr uint8_t FLT_MAX = filter_convergence(true);
-static constexpr uint8_t FLT_MIN = filter_convergence(false);
+template <typename T>
+static constexpr T FLT_MAX = filter_convergence<T>(FIXED_POINT_BASE<T>);
+template <typename T>
+static constexpr T FLT_MIN = filter_convergence<T>(0);
+
+static constexpr uint16_t QUALITY_PERIOD = 1000;
+
+static constexpr uint8_t AMPLITUDE_TRACK_LOG2 = 7;
 
-debounce::debounce(uint8_t hysteresis)
-    : m_low_pass(FIXED_POINT_BASE / 2), m_last_t(0), m_last_state_change(0),
-      m_hysteresis((uint16_t(hysteresis) * (FLT_MAX - FLT_MIN)) >> 8),
-      m_last_input_value(false)
+static uint16_t track(uint16_t x, uint16_t a)
 {
+	return a > x ? x + ((a - x) >> AMPLITUDE_TRACK_LOG2)
+	             : x - ((x - a) >> AMPLITUDE_TRACK_LOG2);
 }
 
-const debounce::result &debounce::sample(bool value, uint16_t t)
+template <typename T>
+static void accumulate_quality(T x, T hysteresis, uint16_t dt,
+                               uint16_t &transition_time, uint16_t &deviation)
+{
+	// Measure the distance of the low-pass filter from the level it would
+	// reach for a clean input signal, or the time spent between the
+	// thresholds. The distance is scaled to seven bits independent of T.
+	constexpr uint8_t shift = FIXED_POINT_LOG2_BASE<T> - 7;
+	if (x > FLT_MAX<T> - hysteresis) {
+		const uint8_t d = (FLT_MAX<T> - x) >> shift;
+		const uint32_t s = deviation + uint32_t((d * d) >> 2) * dt;
+		deviation = s > 0xFFFF ? 0xFFFF : s;
+	} else if (x < FLT_MIN<T> + hysteresis) {
+		const uint8_t d = (x - FLT_MIN<T>) >> shift;
+		const uint32_t s = deviation + uint32_t((d * d) >> 2) * dt;
+		deviation = s > 0xFFFF ? 0xFFFF : s;
+	} else {
+		transition_time += dt;
+	}
+}
+
+template <typename T>
+static void nominal_quality(T hysteresis, uint16_t &transition_time,
+                            uint16_t &deviation)
+{
+	// Feed a falling and a rising step of a noise-free input through the
+	// filter until the scaled distance from the final level vanishes. Half of
+	// the accumulated statistics is what a single clean edge contributes.
+	constexpr uint8_t shift = FIXED_POINT_LOG2_BASE<T> - 7;
+	transition_time = 0;
+	deviation = 0;
+	for (T x = FLT_MAX<T>; (x - FLT_MIN<T>) >> shift;) {
+		x = filter(T(0), x);
+		accumulate_quality(x, hysteresis, 1, transition_time, deviation);
+	}
+	for (T x = FLT_MIN<T>; (FLT_MAX<T> - x) >> shift;) {
+		x = filter(FIXED_POINT_BASE<T>, x);
+		accumulate_quality(x, hysteresis, 1, transition_time, deviation);
+	}
+	transition_time /= 2;
+	deviation /= 2;
+}
+
+template <typename T>
+DCF77_INLINE basic_debounce<T>::basic_debounce(uint8_t hysteresis,
+                                                uint16_t max_gap)
+    : m_low_pass(FIXED_POINT_BASE<T> / 2), m_last_t(0), m_last_state_change(0),
+      m_hysteresis((typename debounce_traits<T>::wide(hysteresis) *
+                    (FLT_MAX<T> - FLT_MIN<T>)) >>
+                   8),
+      m_max_gap(max_gap), m_last_input_value(false), m_first(true),
+      m_quality_t(0), m_quality_transition_time(0),
+      m_quality_deviation(0), m_quality_changes(0), m_quality_edges(0),
+      m_amplitude_high(0x8000), m_amplitude_low(0x8000)
 {
+	uint16_t transition_time;
+	nominal_quality(m_hysteresis, transition_time, m_nominal_deviation);
+	m_nominal_transition_time =
+	    transition_time > 0xFF ? 0xFF : transition_time;
+}
+
+template <typename T>
+DCF77_INLINE void basic_debounce<T>::update_quality(uint16_t dt, uint16_t t,
+                                                    bool value)
+{
+	accumulate_quality(m_low_pass, m_hysteresis, dt, m_quality_transition_time,
+	                   m_quality_deviation);
+
+	// Latch the statistics once per second
+	const uint16_t period = t - m_quality_t;
+	if (period < QUALITY_PERIOD) {
+		return;
+	}
+
+	// Subtract the response of the filter to the observed edges, which
+	// would also be measured for a noise-free input signal
+	const uint32_t excess_transition_time =
+	    uint32_t(m_nominal_transition_time) * m_quality_edges;
+	const uint32_t excess_deviation =
+	    uint32_t(m_nominal_deviation) * m_quality_edges;
+	const uint16_t transition_time =
+	    m_quality_transition_time > excess_transition_time
+	        ? m_quality_transition_time - excess_transition_time
+	        : 0;
+	const uint16_t deviation = m_quality_deviation > excess_deviation
+	                               ? m_quality_deviation - excess_deviation
+	                               : 0;
+
+	// An input change the filter output has not followed yet usually is the
+	// start of an edge occurring in the next second; count it there
+	const uint8_t pending =
+	    value != m_result.value && m_quality_changes ? 1 : 0;
+	const uint8_t changes = m_quality_changes - pending;
+
+	const uint16_t settled_time =
+	    period > m_quality_transition_time ? period - m_quality_transition_time
+	                                       : 1;
+	const uint16_t variance = deviation / settled_time;
+	m_quality.transition_time = m_quality_transition_time;
+	m_quality.glitches =
+	    changes > m_quality_edges ? changes - m_quality_edges : 0;
+	m_quality.plateau_variance = variance > 0xFF ? 0xFF : variance;
+
+	// Combine the individual measures into a single penalty
+	const uint16_t penalty = m_quality.glitches +
+	                         m_quality.plateau_variance +
+	                         (transition_time >> 2);
+	m_quality.value = penalty > 0xFF ? 0 : 0xFF - penalty;
+	restart_quality(t);
+	m_quality_changes = pending;
+}
+
+template <typename T>
+DCF77_INLINE void basic_debounce<T>::restart_quality(uint16_t t)
+{
+	m_quality_t = t;
+	m_quality_transition_time = 0;
+	m_quality_deviation = 0;
+	m_quality_changes = 0;
+	m_quality_edges = 0;
+}
+
+template <typename T>
+DCF77_INLINE const debounce_base::result &basic_debounce<T>::sample(
+    bool value, uint16_t t)
+{
+	return update(value ? FIXED_POINT_BASE<T> : 0, value, t);
+}
+
+template <typename T>
+DCF77_INLINE const debounce_base::result &basic_debounce<T>::sample_amplitude(
+    uint8_t amplitude, uint16_t t)
+{
+	// Track the mean high and low carrier amplitudes. Depending on the
+	// current filter output, the sample updates either the high or the low
+	// level. Samples outside of the range between both levels always update
+	// the nearest level, which guarantees convergence independent of the
+	// initial values.
+	const uint16_t a = uint16_t(amplitude) << 8;
+	if (m_result.value || a > m_amplitude_high) {
+		m_amplitude_high = track(m_amplitude_high, a);
+	}
+	if (!m_result.value || a < m_amplitude_low) {
+		m_amplitude_low = track(m_amplitude_low, a);
+	}
+
+	// Map the amplitude onto the filter input range. Only the middle half
+	// between the low and the high level is mapped linearly, amplitudes
+	// closer to either level saturate.
+	const uint8_t high = m_amplitude_high >> 8;
+	const uint8_t low = m_amplitude_low >> 8;
+	const uint8_t margin = high > low ? (high - low) >> 2 : 0;
+	using wide = typename debounce_traits<T>::wide;
+	T level;
+	if (uint16_t(amplitude) + margin >= high) {
+		level = FIXED_POINT_BASE<T>;
+	} else if (amplitude <= uint16_t(low) + margin) {
+		level = 0;
+	} else {
+		level = (wide(amplitude - low - margin) << FIXED_POINT_LOG2_BASE<T>) /
+		        (high - low - 2 * margin);
+	}
+
+	// Apply a hysteresis to the level before using it to timestamp the input
+	// state changes, so that noise does not shift the timestamps
+	const bool value =
+	    m_last_input_value ? level > FIXED_POINT_BASE<T> / 4
+	                       : level >= wide(FIXED_POINT_BASE<T>) * 3 / 4;
+	return update(level, value, t);
+}
+
+template <typename T>
+DCF77_INLINE const debounce_base::result &basic_debounce<T>::update(
+    T level, bool value, uint16_t t)
+{
+	// Check the timestamp. Small backward steps are ignored, larger jumps in
+	// either direction hold the filter state instead of extrapolating the
+	// last input across the gap. The first sample starts the time base.
+	uint16_t dt = t - m_last_t;
+	m_result.non_monotonic = false;
+	m_result.gap = false;
+	if (dt > m_max_gap || m_first) {
+		if (m_first) {
+			m_first = false;
+		} else if (dt > 0x8000 && uint16_t(-dt) <= m_max_gap) {
+			m_result.non_monotonic = true;
+			m_result.edge = false;
+			return m_result;
+		} else {
+			m_result.gap = true;
+		}
+		restart_quality(t);
+		dt = 0;
+	}
+
 	// Apply a low-pass filter to the input signal
-	const uint16_t dt = t - m_last_t;
-	uint8_t lv = m_low_pass;
+	T lv = m_low_pass;
 	for (uint16_t i = 0; i < dt; i++) {
-		m_low_pass = filter(value, m_low_pass);
+		m_low_pass = filter(level, m_low_pass);
 		if (m_low_pass == lv) {
 			break;
 		}
@@ -68,20 +278,27 @@ const debounce::result &debounce::sample(bool value, uint16_t t)
 	// Remember the time of the last state change
 	if (value != m_last_input_value) {
 		m_last_state_change = t;
+		if (m_quality_changes < 0xFF) {
+			m_quality_changes++;
+		}
 	}
 
 	// Assemble the result structure, apply the hysteresis
-	if (m_low_pass > FLT_MAX - m_hysteresis && m_result.value == false) {
+	if (m_low_pass > FLT_MAX<T> - m_hysteresis && !m_result.value) {
 		m_result.t = m_last_state_change;
 		m_result.edge = true;
 		m_result.value = true;
-	} else if (m_low_pass < FLT_MIN + m_hysteresis && m_result.value == true) {
+	} else if (m_low_pass < FLT_MIN<T> + m_hysteresis && m_result.value) {
 		m_result.t = m_last_state_change;
 		m_result.edge = true;
 		m_result.value = false;
 	} else {
 		m_result.edge = false;
 	}
+	if (m_result.edge && m_quality_edges < 0xFF) {
+		m_quality_edges++;
+	}
+	update_quality(dt, t, value);
 
 	// Remember time and input/output values
 	m_last_t = t;
@@ -90,12 +307,18 @@ const debounce::result &debounce::sample(bool value, uint16_t t)
 	return m_result;
 }
 
+#ifndef DCF77_HEADER_ONLY
+template class basic_debounce<uint8_t>;
+template class basic_debounce<uint16_t>;
+template class basic_debounce<uint32_t>;
+#endif
+
 /******************************************************************************
  * Union "data"                                                               *
  ******************************************************************************/
 
 template <typename T>
-uint8_t parity(T x)
+static uint8_t parity(T x)
 {
 	return __builtin_popcount(x) & 1;
 }
@@ -125,30 +348,335 @@ static bool valid_bcd(T x)
 	return true;
 };
 
-bool data::valid(bool time_and_date_only) const
+DCF77_INLINE uint8_t data::validate() const
+{
+	uint8_t res = 0;
+	if ((raw.time_start == 1) && // Constant flag
+	    (raw.parity_minute == parity(raw.minute)) && // Check parity
+	    valid_bcd<5, 9>(raw.minute)) {               // Check BCD value
+		res |= VALID_MINUTE;
+	}
+	if ((raw.parity_hour == parity(raw.hour)) && valid_bcd<2, 3>(raw.hour)) {
+		res |= VALID_HOUR;
+	}
+	if ((raw.parity_date ==
+	     parity(uint32_t((bitstream & 0x3FFFFF000000000LL) >> 32))) &&
+	    valid_bcd<3, 1>(raw.day) && (raw.day > 0) && (raw.day_of_week > 0) &&
+	    valid_bcd<1, 2>(raw.month) && (raw.month > 0) &&
+	    valid_bcd<9, 9>(raw.year)) {
+		res |= VALID_DATE;
+	}
+	if ((raw.minute_start == 0) && // Constant flag
+	    (raw.cest != raw.cet)) {   // There can be only one!
+		res |= VALID_FLAGS;
+	}
+	return res;
+}
+
+DCF77_INLINE uint32_t data::unix_time() const
 {
-	return (time_and_date_only || raw.minute_start == 0) &&
-	       (raw.time_start == 1) // Constant flags
-	       &&
-	       (time_and_date_only || raw.cest != raw.cet) // There can be only one!
-	       && (raw.parity_minute == parity(raw.minute)) && // Check parity
-	       (raw.parity_hour == parity(raw.hour)) &&
-	       (raw.parity_date ==
-	        parity(uint32_t((bitstream & 0x3FFFFF000000000LL) >> 32))) &&
-	       valid_bcd<5, 9>(raw.minute) && // Check BCD values
-	       valid_bcd<2, 3>(raw.hour) && valid_bcd<3, 1>(raw.day) &&
-	       (raw.day > 0) && (raw.day_of_week > 0) &&
-	       valid_bcd<1, 2>(raw.month) && (raw.month > 0) &&
-	       valid_bcd<9, 9>(raw.year);
+	// Days before the first of each month in a non-leap year
+	static constexpr uint16_t MONTH_DAYS[12] = {0,   31,  59,  90,  120, 151,
+	                                            181, 212, 243, 273, 304, 334};
+
+	// All years between 2000 and 2099 divisible by four are leap years
+	const uint8_t y = decode_bcd(raw.year);
+	const uint8_t m = month();
+	uint32_t days = 10957UL + 365UL * y + (y + 3) / 4;
+	if (m >= 1 && m <= 12) {
+		days += MONTH_DAYS[m - 1];
+		if (m > 2 && (y % 4) == 0) {
+			days++;
+		}
+	}
+	days += day() - 1;
+
+	// CET is UTC+1, CEST is UTC+2
+	const uint8_t utc_hour_offs = raw.cest ? 2 : 1;
+	return ((days * 24UL + hour()) * 60UL + minute()) * 60UL -
+	       utc_hour_offs * 3600UL;
 }
 
 /******************************************************************************
  * Class "decoder"                                                            *
  ******************************************************************************/
 
-decoder::state decoder::sample(bool value, uint16_t t)
+static constexpr uint64_t FRAME_MASK = (uint64_t(1) << 59) - 1;
+static constexpr uint64_t FLAGS_MASK = (uint64_t(1) << 20) - 1;
+static constexpr uint64_t MINUTE_MASK = ((uint64_t(1) << 9) - 1) << 20;
+static constexpr uint64_t HOUR_MASK = ((uint64_t(1) << 7) - 1) << 29;
+static constexpr uint64_t DATE_MASK = ((uint64_t(1) << 23) - 1) << 36;
+
+DCF77_INLINE decoder::state decoder::finish_frame(data &frame, uint8_t n_bits,
+                                                  uint8_t &validity)
+{
+	// Fields which were not received entirely are not valid, even if the
+	// zero-filled bits happen to pass validation
+	const uint8_t first = n_bits < 59 ? 59 - n_bits : 0;
+	frame.bitstream = frame.bitstream << first;
+	validity = frame.validate();
+	if (first > 0) {
+		validity &= ~data::VALID_FLAGS;
+	}
+	if (first > 20) {
+		validity &= ~data::VALID_MINUTE;
+	}
+	if (first > 29) {
+		validity &= ~data::VALID_HOUR;
+	}
+	if (first > 36) {
+		validity &= ~data::VALID_DATE;
+	}
+	if (n_bits >= 59 && validity == data::VALID_ALL) {
+		return state::has_complete;
+	}
+	if ((validity & data::VALID_TIME_AND_DATE) == data::VALID_TIME_AND_DATE) {
+		return state::has_time_and_date;
+	}
+	if ((validity & data::VALID_TIME) == data::VALID_TIME) {
+		return state::has_time;
+	}
+	return state::invalid_result;
+}
+
+DCF77_INLINE void decoder::publish(state res, uint8_t validity,
+                                   uint16_t phase)
+{
+	if (res < state::has_time) {
+		return;
+	}
+
+	// Only copy the fields which passed validation
+	uint64_t mask = 0;
+	if (validity & data::VALID_MINUTE) {
+		mask |= MINUTE_MASK;
+	}
+	if (validity & data::VALID_HOUR) {
+		mask |= HOUR_MASK;
+	}
+	if (validity & data::VALID_DATE) {
+		mask |= DATE_MASK;
+	}
+	if (validity & data::VALID_FLAGS) {
+		mask |= FLAGS_MASK;
+	}
+	m_data_current.bitstream = (m_data_current.bitstream & ~mask) |
+	                           (m_data_new.bitstream & mask);
+	m_validity = validity;
+	m_phase = phase;
+
+#ifdef DCF77_FRAME_CACHE
+	// Share complete frames with the other decoders
+	if (m_cache && res == state::has_complete) {
+		m_cache->confirm(m_data_new, phase);
+	}
+#endif
+}
+
+DCF77_INLINE decoder::state decoder::finish_current_frame(uint8_t &validity)
 {
-	auto event = m_debouncer.sample(value, t);
+#ifdef DCF77_FRAME_CACHE
+	// If all bits checked by data::validate() equal those of the predicted
+	// frame, the frame is valid as well
+	if (m_n_verified == frame_cache::PREDICTABLE_BITS &&
+	    m_state == FRAME_BITS) {
+		validity = data::VALID_ALL;
+		return state::has_complete;
+	}
+#endif
+	return finish_frame(m_data_new, m_state, validity);
+}
+
+DCF77_INLINE void decoder::clear_frame()
+{
+	m_state = 0;
+	m_data_new.bitstream = 0;
+#ifdef DCF77_FRAME_CACHE
+	m_n_verified = 0;
+#endif
+}
+
+#ifdef DCF77_FRAME_CACHE
+DCF77_INLINE void decoder::verify_bit(uint8_t index, bool bit)
+{
+	// The falling edge which started the bit is index seconds after the
+	// start of the frame
+	bool expected;
+	if (!m_cache ||
+	    !m_cache->expect(m_last_t - index * SECOND_TIME, index, expected)) {
+		return;
+	}
+	m_bits_checked++;
+	if (bit == expected) {
+		m_n_verified++;
+	} else {
+		m_bit_errors++;
+	}
+}
+#endif
+
+DCF77_INLINE decoder::state decoder::sample(bool value, uint16_t t)
+{
+	return process(m_debouncer.sample(value, t), t);
+}
+
+DCF77_INLINE decoder::state decoder::sample_amplitude(uint8_t amplitude,
+                                                      uint16_t t)
+{
+	return process(m_debouncer.sample_amplitude(amplitude, t), t);
+}
+
+/**
+ * Rotates the 59-bit word w by n bits, so that bit i of the result is bit
+ * (i + n) mod 59 of w.
+ */
+static uint64_t rotate_frame(uint64_t w, uint8_t n)
+{
+	return n == 0 ? w : ((w >> n) | (w << (59 - n))) & FRAME_MASK;
+}
+
+static uint8_t bcd_increment(uint8_t x)
+{
+	return (x & 0x0F) == 9 ? (x & 0xF0) + 0x10 : x + 1;
+}
+
+/**
+ * Returns the date bits (including the parity) of the day following the date
+ * contained in the given frame. Valid for the years 2000 to 2099.
+ */
+static uint64_t next_date(const data &frame)
+{
+	static constexpr uint8_t MONTH_LENGTH[12] = {
+	    0x31, 0x28, 0x31, 0x30, 0x31, 0x30, 0x31, 0x31, 0x30, 0x31, 0x30, 0x31};
+	const uint8_t m = frame.month();
+	uint8_t last = m >= 1 && m <= 12 ? MONTH_LENGTH[m - 1] : 0x31;
+	if (m == 2 && (data::decode_bcd(frame.raw.year) % 4) == 0) {
+		last = 0x29;
+	}
+
+	data res = frame;
+	if (frame.raw.day < last) {
+		res.raw.day = bcd_increment(frame.raw.day);
+	} else if (frame.raw.month < 0x12) {
+		res.raw.day = 1;
+		res.raw.month = bcd_increment(frame.raw.month);
+	} else {
+		res.raw.day = 1;
+		res.raw.month = 1;
+		res.raw.year =
+		    frame.raw.year == 0x99 ? 0 : bcd_increment(frame.raw.year);
+	}
+	res.raw.day_of_week = frame.raw.day_of_week % 7 + 1;
+	res.raw.parity_date =
+	    parity(uint32_t((res.bitstream & 0x3FFFFF000000000LL) >> 32));
+	return res.bitstream & DATE_MASK;
+}
+
+DCF77_INLINE void decoder::push_history(bool bit)
+{
+	if (bit) {
+		m_history |= uint64_t(1) << m_history_pos;
+	} else {
+		m_history &= ~(uint64_t(1) << m_history_pos);
+	}
+	m_history_pos = (m_history_pos + 1 == FRAME_BITS) ? 0 : m_history_pos + 1;
+	if (m_history_len < FRAME_BITS) {
+		m_history_len++;
+	}
+}
+
+DCF77_INLINE bool decoder::align()
+{
+	if (m_history_len < FRAME_BITS) {
+		return false;
+	}
+
+	// Check the constant bits and the parities for all rotations at once. Bit
+	// r of each mask corresponds to a frame starting at m_history bit r.
+	uint64_t w = m_history, minute_start = 0, cest = 0, cet = 0,
+	         time_start = 0, parity_minute = 0, parity_hour = 0,
+	         parity_date = 0;
+	for (uint8_t k = 0; k < FRAME_BITS; k++) {
+		if (k == 0) {
+			minute_start = w;
+		} else if (k == 17) {
+			cest = w;
+		} else if (k == 18) {
+			cet = w;
+		} else if (k == 20) {
+			time_start = w;
+		} else if (k >= 21 && k <= 28) {
+			parity_minute ^= w;
+		} else if (k >= 29 && k <= 35) {
+			parity_hour ^= w;
+		} else if (k >= 36) {
+			parity_date ^= w;
+		}
+		w = (w >> 1) | ((w & 1) << (FRAME_BITS - 1));
+	}
+	uint64_t candidates = ~minute_start & (cest ^ cet) & time_start &
+	                      ~parity_minute & ~parity_hour & ~parity_date &
+	                      FRAME_MASK;
+
+	// Validate the remaining candidates, accept a unique match only. A
+	// rotation contains the beginning of the current and the end of the
+	// previous minute, so the date must match the last published date or,
+	// if midnight passed since, the following day. Without a published date,
+	// any date is accepted.
+	const uint64_t date = m_data_current.bitstream & DATE_MASK;
+	const uint64_t date_next = date != 0 ? next_date(m_data_current) : 0;
+	uint8_t start = 0, n_matches = 0;
+	for (uint8_t r = 0; candidates != 0; r++, candidates >>= 1) {
+		if (!(candidates & 1)) {
+			continue;
+		}
+		data frame;
+		frame.bitstream = rotate_frame(m_history, r);
+		if (!frame.valid(false)) {
+			continue;
+		}
+		const uint64_t frame_date = frame.bitstream & DATE_MASK;
+		if (date != 0 && frame_date != date && frame_date != date_next) {
+			continue;
+		}
+		start = r;
+		n_matches++;
+	}
+	if (n_matches != 1) {
+		return false;
+	}
+
+	// Copy the bits received since the start of the minute into the working
+	// data register. If a complete minute was received, the frame is
+	// concluded once the first bit of the next minute arrives.
+	const uint8_t n_bits =
+	    (m_history_pos + 2 * FRAME_BITS - start - 1) % FRAME_BITS + 1;
+	const uint64_t mask =
+	    n_bits == FRAME_BITS ? FRAME_MASK : (uint64_t(1) << n_bits) - 1;
+	m_data_new.bitstream = rotate_frame(m_history, start) & mask;
+	m_state = n_bits;
+#ifdef DCF77_FRAME_CACHE
+	m_n_verified = 0;
+#endif
+	return true;
+}
+
+DCF77_INLINE decoder::state decoder::process(const debounce::result &event,
+                                             uint16_t t)
+{
+	// After a gap, the bits received so far no longer line up with the
+	// following seconds. Discard them and search for the start of the minute
+	// again.
+	if (event.gap) {
+		clear_frame();
+		m_history_len = 0;
+		m_synced = false;
+		m_last_t = t;
+	}
+	if (event.gap || event.non_monotonic) {
+		return state::discontinuity;
+	}
+
 	state res = state::no_result;
 	if (event.edge) {
 		uint16_t dt = event.t - m_last_t;
@@ -156,36 +684,163 @@ decoder::state decoder::sample(bool value, uint16_t t)
 			// Falling edge
 			if (dt > SYNC_HIGH_TIME - SLACK) {
 				// Handle a sync event
-				if (m_state < 59) {
-					m_data_new.bitstream = m_data_new.bitstream
-					                       << (59 - m_state);
-					if (m_data_new.valid(true)) {
-						res = state::has_time_and_date;
-					}
-				} else if (m_data_new.valid(false)) {
-					res = state::has_complete;
-				}
-				if (res >= state::has_time_and_date) {
-					m_data_current = m_data_new;
-					m_phase = event.t;
-				}
-				m_state = 0;
-				m_data_new.bitstream = 0;
+				uint8_t validity;
+				res = finish_current_frame(validity);
+				publish(res, validity, event.t);
+				clear_frame();
+				m_synced = true;
 			}
 		}
 		if (event.value) {
 			// Rising edge
 			if (dt > LOW_ZERO_TIME - SLACK) {
-				// We received a "one" or a "zero"
-				if (dt > LOW_ONE_TIME - SLACK) {
+				// We received a "one" or a "zero". Check whether the pulse
+				// started at the time expected for the next second or, after
+				// the synchronisation gap, for the next minute.
+				const uint16_t gap = m_last_t - m_last_bit_t;
+				const bool next_second =
+				    gap >= SECOND_TIME - LOW_ONE_TIME - SLACK &&
+				    gap <= SECOND_TIME - LOW_ZERO_TIME + SLACK;
+				const bool next_minute =
+				    gap > SYNC_HIGH_TIME - SLACK &&
+				    gap <= SYNC_HIGH_TIME + LOW_ZERO_TIME + SLACK;
+				const bool timeout =
+				    gap > SYNC_HIGH_TIME + LOW_ZERO_TIME + SLACK;
+				const bool regular = next_second || next_minute || timeout ||
+				                     m_history_len == 0;
+
+				// If a complete minute has already been received, the
+				// synchronisation gap was corrupted. Conclude the minute if
+				// this pulse is the first second of the next minute and
+				// ignore glitches within the gap.
+				if (m_synced && m_state == FRAME_BITS &&
+				    !m_data_new.raw.leap_second) {
+					if (!regular) {
+						m_last_t = event.t;
+						return res;
+					}
+					if (next_minute) {
+						uint8_t validity;
+						res = finish_current_frame(validity);
+						publish(res, validity, m_last_t);
+					} else {
+						m_synced = false;
+					}
+					clear_frame();
+				}
+
+				const bool bit = dt > LOW_ONE_TIME - SLACK;
+#ifdef DCF77_FRAME_CACHE
+				if (m_synced && m_state < FRAME_BITS) {
+					verify_bit(m_state, bit);
+				}
+#endif
+				if (bit && m_state < 64) {
 					// It's a "one"
 					m_data_new.bitstream |= uint64_t(1) << m_state;
 				}
-				m_state++;
+				if (m_state < 0xFF) {
+					m_state++;
+				}
+
+				// Only record pulses with plausible timing in the history,
+				// so that glitches do not break its periodic structure.
+				// Search for the start of the minute if the decoder is not
+				// synchronised.
+				if (regular) {
+					m_last_bit_t = event.t;
+					push_history(bit);
+					if (!m_synced || m_state > FRAME_BITS + 1) {
+						m_synced = align();
+					}
+				}
+
+				// The pulse started with the last falling edge
+				m_second.t = m_last_t;
+				m_second.second = m_synced && m_state <= FRAME_BITS + 1
+				                      ? m_state - 1
+				                      : NO_SECOND;
+				m_second.bit = bit;
+				m_second.count++;
 			}
 		}
 		m_last_t = event.t;
 	}
 	return res;
 }
+
+DCF77_INLINE void decoder::classify_edges(const uint16_t *edges,
+                                          uint8_t *pulses, size_t n,
+                                          bool first_falling)
+{
+	// Branch-free loop over the edge differences, allows the compiler to
+	// vectorise the classification
+	const uint8_t high_parity = first_falling ? 0 : 1;
+	for (size_t i = 0; i + 1 < n; i++) {
+		const uint16_t dt = edges[i + 1] - edges[i];
+		const uint8_t high = (uint8_t(i) ^ high_parity) & 1;
+		const uint8_t bit = (dt > LOW_ZERO_TIME - SLACK) * PULSE_BIT;
+		const uint8_t one = (dt > LOW_ONE_TIME - SLACK) * PULSE_ONE;
+		const uint8_t sync = (dt > SYNC_HIGH_TIME - SLACK) * PULSE_SYNC;
+		pulses[i] = high ? sync : (bit | one);
+	}
+}
+
+DCF77_INLINE size_t decoder::assemble_frames(const uint8_t *pulses, size_t n,
+                                             frame_candidate *frames,
+                                             size_t max_frames)
+{
+	size_t n_frames = 0;
+	data frame;
+	uint8_t n_bits = 0;
+	for (size_t i = 0; i < n && n_frames < max_frames; i++) {
+		const uint8_t p = pulses[i];
+		if (p & PULSE_SYNC) {
+			frame_candidate &c = frames[n_frames++];
+			c.n_bits = n_bits;
+			c.result = finish_frame(frame, n_bits, c.validity);
+			c.frame = frame;
+			c.sync = i + 1;
+			frame.bitstream = 0;
+			n_bits = 0;
+		} else if (p & PULSE_BIT) {
+			if (n_bits < 64) {
+				frame.bitstream |= uint64_t((p & PULSE_ONE) ? 1 : 0) << n_bits;
+				n_bits++;
+			}
+		}
+	}
+	return n_frames;
+}
+
+/******************************************************************************
+ * Class "frame_cache"                                                        *
+ ******************************************************************************/
+
+DCF77_INLINE void frame_cache::confirm(const data &frame, uint16_t phase)
+{
+	m_expected = frame;
+	m_mask = PREDICTABLE_MASK;
+	m_phase = phase;
+
+	// Advance the time by one minute. At the end of the hour, the next frame
+	// may contain a leap second or switch between CET and CEST; at the end
+	// of the day, the date changes.
+	if (frame.raw.minute != 0x59) {
+		m_expected.raw.minute = bcd_increment(frame.raw.minute);
+	} else if (frame.raw.leap_second || frame.raw.dst_leap_hour) {
+		m_mask = 0;
+	} else if (frame.raw.hour != 0x23) {
+		m_expected.raw.minute = 0;
+		m_expected.raw.hour = bcd_increment(frame.raw.hour);
+	} else {
+		m_expected.raw.minute = 0;
+		m_expected.raw.hour = 0;
+		m_mask &= ~DATE_MASK;
+	}
+	m_expected.raw.parity_minute = parity(m_expected.raw.minute);
+	m_expected.raw.parity_hour = parity(m_expected.raw.hour);
+}
 }
+
+#endif /* DCF77_CPP */
@@ -25,23 +25,102 @@
  * @author Andreas Stöckel
  */
 
+#ifndef DCF77_HPP
+#define DCF77_HPP
+
+#include <stddef.h>
 #include <stdint.h>
 
+/**
+ * If DCF77_HEADER_ONLY is defined before including this header, the
+ * implementation in dcf77.cpp is included as well and all functions are
+ * declared inline. This allows the compiler to inline the sample() methods
+ * into the caller's loop or interrupt service routine. In this case dcf77.cpp
+ * must not be compiled separately.
+ */
+#ifdef DCF77_HEADER_ONLY
+#define DCF77_INLINE inline
+#else
+#define DCF77_INLINE
+#endif
+
+/**
+ * If defined, selects the fixed-point type used by the low-pass filter of the
+ * decoder class. Defaults to uint8_t, which is the most efficient choice for
+ * 8-bit microcontrollers. On hosts, uint16_t or uint32_t increase the
+ * resolution of the filter coefficient and state. Must be defined
+ * consistently for all translation units, for example on the compiler command
+ * line.
+ */
+#ifndef DCF77_DEBOUNCE_TYPE
+#define DCF77_DEBOUNCE_TYPE uint8_t
+#endif
+
+/**
+ * If defined, decoders can be attached to a frame_cache shared with other
+ * decoders receiving the same signal and count the bit errors of their
+ * receiver, see decoder::set_frame_cache(). This adds the cache pointer and
+ * the bit counters to each decoder, so it is disabled by default. Must be
+ * defined consistently for all translation units.
+ */
+
 /**
  * Namespace encompassing all types used in the DCF77 decoder.
  */
 namespace dcf77 {
 
 /**
- * A digital low-pass filter with Schmitt-Trigger and user-definable
- * hysteresis. The filter is a simple finite impulse response filter with a
- * single coefficient (also known as moving average or exponential filter). As
- * an important feature for time signal analysis, the debounce filter allows to
- * recover the current input signal phase, allowing for a reconstruction of the
- * current time.
+ * Describes the fixed-point format used by basic_debounce for a given state
+ * type T. Specialisations exist for uint8_t, uint16_t and uint32_t.
  */
-class debounce {
-public:
+template <typename T>
+struct debounce_traits;
+
+template <>
+struct debounce_traits<uint8_t> {
+	/**
+	 * Type used for intermediate products.
+	 */
+	using wide = uint16_t;
+
+	/**
+	 * Number of fractional bits.
+	 */
+	static constexpr uint8_t LOG2_BASE = 7;
+
+	/**
+	 * Default hysteresis passed to the constructor. The eight bit filter
+	 * saturates at about 3/4 of its range due to rounding, which narrows the
+	 * effective hysteresis band. The wider variants use a larger default to
+	 * obtain a band of similar width.
+	 */
+	static constexpr uint8_t HYSTERESIS = 64;
+};
+
+template <>
+struct debounce_traits<uint16_t> {
+	using wide = uint32_t;
+	static constexpr uint8_t LOG2_BASE = 15;
+	static constexpr uint8_t HYSTERESIS = 80;
+};
+
+template <>
+struct debounce_traits<uint32_t> {
+	using wide = uint64_t;
+	static constexpr uint8_t LOG2_BASE = 31;
+	static constexpr uint8_t HYSTERESIS = 80;
+};
+
+/**
+ * Types shared by all basic_debounce variants.
+ */
+struct debounce_base {
+	/**
+	 * Default maximum time in milliseconds between two calls to sample()
+	 * which is treated as continuous input.
+	 */
+	static constexpr uint16_t MAX_GAP = 1000;
+
 	/**
 	 * Structure describing the output of the debounce filter.
 	 */
@@ -61,14 +140,88 @@ public:
 		 */
 		bool edge : 1;
 
-		result() : t(0), value(false), edge(false) {}
+		/**
+		 * True if the timestamp was slightly smaller than the previous one,
+		 * for example because the timer was read while its interrupt was
+		 * pending. The sample was ignored.
+		 */
+		bool non_monotonic : 1;
+
+		/**
+		 * True if more than the maximum gap passed since the previous sample,
+		 * or the timestamp jumped backwards by more than the maximum gap. The
+		 * filter state was held across the gap and the quality measurement
+		 * was restarted.
+		 */
+		bool gap : 1;
+
+		result()
+		    : t(0), value(false), edge(false), non_monotonic(false), gap(false)
+		{
+		}
+	};
+
+	/**
+	 * Structure describing the quality of the input signal during the last
+	 * full second (1000 timestamp units) of input. All values are derived from
+	 * the low-pass filter state and are updated once per second.
+	 */
+	struct quality {
+		/**
+		 * Time in milliseconds the low-pass filtered value spent between the
+		 * two switching thresholds of the Schmitt-Trigger. A clean DCF77
+		 * signal crosses this region twice per second.
+		 */
+		uint16_t transition_time;
+
+		/**
+		 * Number of input changes which did not result in an edge at the
+		 * output of the filter. An edge lagging behind its input change
+		 * across the end of a second is counted in the following second.
+		 */
+		uint8_t glitches;
+
+		/**
+		 * Mean squared distance (divided by four) of the settled low-pass
+		 * filtered value from the level it would reach for a noise-free input.
+		 */
+		uint8_t plateau_variance;
+
+		/**
+		 * Combined quality metric as a fixed-point number with eight
+		 * fractional bits. The transition time and deviation a noise-free
+		 * edge causes by passing through the filter are not penalised, so
+		 * 255 corresponds to a perfectly clean input signal, zero to pure
+		 * noise.
+		 */
+		uint8_t value;
+
+		quality()
+		    : transition_time(0), glitches(0), plateau_variance(0), value(0)
+		{
+		}
 	};
+};
 
+/**
+ * A digital low-pass filter with Schmitt-Trigger and user-definable
+ * hysteresis. The filter is a simple finite impulse response filter with a
+ * single coefficient (also known as moving average or exponential filter). As
+ * an important feature for time signal analysis, the debounce filter allows to
+ * recover the current input signal phase, allowing for a reconstruction of the
+ * current time.
+ *
+ * @tparam T is the unsigned integer type holding the filter state, see
+ * debounce_traits. Wider types represent the filter coefficient and state
+ * more precisely at the cost of RAM and computation time.
+ */
+template <typename T>
+class basic_debounce : public debounce_base {
 private:
 	/**
 	 * Low-pass filtered input value.
 	 */
-	uint8_t m_low_pass;
+	T m_low_pass;
 
 	/**
 	 * Last timestamp passed to the sample() function.
@@ -81,47 +234,165 @@ private:
 	uint16_t m_last_state_change;
 
 	/**
-	 * User-supplied hysteresis.
+	 * User-supplied hysteresis, scaled to the filter range.
+	 */
+	T m_hysteresis;
+
+	/**
+	 * Time a noise-free edge spends between the thresholds, see
+	 * m_nominal_deviation.
+	 */
+	uint8_t m_nominal_transition_time;
+
+	/**
+	 * Squared distance from the ideal levels accumulated while the filter
+	 * settles after a noise-free edge. Both values only depend on the
+	 * hysteresis and are subtracted from the statistics of each edge.
+	 */
+	uint16_t m_nominal_deviation;
+
+	/**
+	 * Maximum time between two samples treated as continuous input.
 	 */
-	uint8_t m_hysteresis;
+	uint16_t m_max_gap;
 
 	/**
 	 * Last input value received by the sample function.
 	 */
 	bool m_last_input_value;
 
+	/**
+	 * True until the first sample was processed.
+	 */
+	bool m_first;
+
 	/**
 	 * Current/last result.
 	 */
 	result m_result;
 
+	/**
+	 * Timestamp at which the current signal quality measurement started.
+	 */
+	uint16_t m_quality_t;
+
+	/**
+	 * Accumulated time the low-pass filter spent between the thresholds.
+	 */
+	uint16_t m_quality_transition_time;
+
+	/**
+	 * Accumulated squared distance from the ideal low-pass filter levels.
+	 */
+	uint16_t m_quality_deviation;
+
+	/**
+	 * Number of input changes during the current measurement.
+	 */
+	uint8_t m_quality_changes;
+
+	/**
+	 * Number of output edges during the current measurement.
+	 */
+	uint8_t m_quality_edges;
+
+	/**
+	 * Signal quality measured during the last full second.
+	 */
+	quality m_quality;
+
+	/**
+	 * Tracked mean high carrier amplitude as 8.8 fixed-point number.
+	 */
+	uint16_t m_amplitude_high;
+
+	/**
+	 * Tracked mean low carrier amplitude as 8.8 fixed-point number.
+	 */
+	uint16_t m_amplitude_low;
+
+	/**
+	 * Accumulates the signal quality statistics and latches them into
+	 * m_quality once per second. The value is the current input value.
+	 */
+	void update_quality(uint16_t dt, uint16_t t, bool value);
+
+	/**
+	 * Discards the signal quality statistics accumulated so far and starts a
+	 * new measurement at the given time.
+	 */
+	void restart_quality(uint16_t t);
+
+	/**
+	 * Feeds the given input level into the low-pass filter and applies the
+	 * hysteresis.
+	 *
+	 * @param level is the input level between zero (low carrier amplitude)
+	 * and FIXED_POINT_BASE (high carrier amplitude).
+	 * @param value is the binary input state used to timestamp edges.
+	 * @param t is the current timestamp.
+	 */
+	const result &update(T level, bool value, uint16_t t);
+
 public:
 	/**
 	 * Constructor of the debounce class with user-definable hysteresis.
 	 *
 	 * @param hysteresis is a value between zero and 255, which is mapped to a
 	 * value between zero and one hundred percent (for example, the default
-	 * value of 64 corresponds to 25 percent). This percentage p is then used to
-	 * derive the values at which the output is switched: if the current output
-	 * of the filter is zero, and the low-pass filtered value reaches 1 - p, the
-	 * filter output is set to one, otherwise, if the current filter output is
-	 * one and the low-pass filtered values reaches p, the output is set to
-	 * zero.
+	 * value of 64 of the eight bit variant corresponds to 25 percent). This
+	 * percentage p is then used to derive the values at which the output is
+	 * switched: if the current output of the filter is zero, and the low-pass
+	 * filtered value reaches 1 - p, the filter output is set to one,
+	 * otherwise, if the current filter output is one and the low-pass filtered
+	 * values reaches p, the output is set to zero.
+	 * @param max_gap is the maximum time in milliseconds between two calls to
+	 * sample() which is treated as continuous input. Longer gaps and
+	 * timestamps jumping backwards are reported in the result.
 	 */
-	debounce(uint8_t hysteresis = 64);
+	basic_debounce(uint8_t hysteresis = debounce_traits<T>::HYSTERESIS,
+	               uint16_t max_gap = MAX_GAP);
 
 	/**
 	 * Processes a new sample.
 	 *
 	 * @param value is the input bit.
 	 * @param t is a monotonous timestamp in milliseconds. This value is used
-	 * to determine the* number of filter steps. The longer the time that has
+	 * to determine the number of filter steps. The longer the time that has
 	 * passed since the last call to "sample", the more filter steps are
-	 * required.
+	 * required. Timestamps which are not monotonous or which jump forward by
+	 * more than the maximum gap are flagged in the result, see
+	 * result::non_monotonic and result::gap.
 	 */
 	const result &sample(bool value, uint16_t t);
+
+	/**
+	 * Processes a new analog sample, such as the output of an envelope
+	 * detector or the RSSI pin of a receiver. The filter tracks the mean high
+	 * and low carrier amplitudes and feeds the relative position of the sample
+	 * between these levels into the low-pass filter, instead of a hard zero or
+	 * one. This requires four additional bytes of RAM.
+	 *
+	 * @param amplitude is the carrier amplitude, larger values correspond to
+	 * a higher amplitude.
+	 * @param t is a monotonous timestamp in milliseconds. The amplitude
+	 * tracking assumes that this function is called about once per
+	 * millisecond.
+	 */
+	const result &sample_amplitude(uint8_t amplitude, uint16_t t);
+
+	/**
+	 * Returns the signal quality measured during the last full second of
+	 * input. May be called at any time.
+	 */
+	const quality &get_quality() const { return m_quality; }
 };
 
+/**
+ * Debounce filter with eight bit state, suitable for microcontrollers.
+ */
+using debounce = basic_debounce<uint8_t>;
+
 #pragma pack(push, 1)
 /**
  * The data union stores the data received from the DCF77 radio station. It
@@ -246,6 +517,54 @@ union data {
 	 */
 	data() : bitstream(0) {}
 
+	/**
+	 * Flag returned by validate() if the time start bit, the minute and its
+	 * parity are valid.
+	 */
+	static constexpr uint8_t VALID_MINUTE = 1;
+
+	/**
+	 * Flag returned by validate() if the hour and its parity are valid.
+	 */
+	static constexpr uint8_t VALID_HOUR = 2;
+
+	/**
+	 * Flag returned by validate() if the day, day of the week, month, year
+	 * and the date parity are valid.
+	 */
+	static constexpr uint8_t VALID_DATE = 4;
+
+	/**
+	 * Flag returned by validate() if the minute start bit is zero and exactly
+	 * one of the CET and CEST bits is set.
+	 */
+	static constexpr uint8_t VALID_FLAGS = 8;
+
+	/**
+	 * Combination of the flags required for the time of day.
+	 */
+	static constexpr uint8_t VALID_TIME = VALID_MINUTE | VALID_HOUR;
+
+	/**
+	 * Combination of the flags required for time and date.
+	 */
+	static constexpr uint8_t VALID_TIME_AND_DATE = VALID_TIME | VALID_DATE;
+
+	/**
+	 * Combination of all validation flags.
+	 */
+	static constexpr uint8_t VALID_ALL = VALID_TIME_AND_DATE | VALID_FLAGS;
+
+	/**
+	 * Validates the individual fields of the data contained in this object.
+	 * Checks the constant flags, the parity and the numerical values for
+	 * validity.
+	 *
+	 * @return a combination of the VALID_MINUTE, VALID_HOUR, VALID_DATE and
+	 * VALID_FLAGS flags describing the valid fields.
+	 */
+	uint8_t validate() const;
+
 	/**
 	 * Validates the data contained in this object. Checks the constant flags,
 	 * the parity and the numerical values for validity. If incomplete data
@@ -255,7 +574,12 @@ union data {
 	 * @param time_and_date_only if true, does not check the validity of the
 	 * first 19 bits of the data stream.
 	 */
-	bool valid(bool time_and_date_only = false) const;
+	bool valid(bool time_and_date_only = false) const
+	{
+		const uint8_t required =
+		    time_and_date_only ? VALID_TIME_AND_DATE : VALID_ALL;
+		return (validate() & required) == required;
+	}
 
 	/**
 	 * Used to decode two-digit bcd values to bits.
@@ -323,9 +647,118 @@ union data {
 	 * Current year. Assumes we are in the 21th century.
 	 */
 	uint16_t year() const { return decode_bcd(raw.year) + 2000; }
+
+	/**
+	 * Number of seconds between 1970-01-01 00:00:00 UTC and the beginning of
+	 * the minute encoded in the transmission. The local time is converted to
+	 * UTC using the CEST flag. Only meaningful if time and date are valid;
+	 * the UTC offset is only meaningful if the flags (VALID_FLAGS) are valid
+	 * as well, which is not the case for a frame received partially.
+	 */
+	uint32_t unix_time() const;
 };
 #pragma pack(pop)
 
+/**
+ * Expected bitstream of the current minute, shared by several decoders
+ * receiving the same transmitter, for example all receivers at one site. Each
+ * decoder attached to the cache using decoder::set_frame_cache() stores every
+ * completely valid frame in the cache, from which the cache predicts the
+ * frame of the following minute. The decoders compare their bits with the
+ * prediction as they arrive, which yields a bit error count per receiver, and
+ * accept a frame matching the prediction without validating it.
+ *
+ * All decoders sharing a cache must use the same timestamps. The cache is not
+ * synchronised; decoders processed by different threads must not share one.
+ * Decoders only support the cache if DCF77_FRAME_CACHE is defined.
+ */
+class frame_cache {
+public:
+	/**
+	 * Bits checked by data::validate(): the minute start bit, the CET and
+	 * CEST bits, the time start bit, the time and the date including the
+	 * parities. Bits 1 to 16 and 19 cannot be predicted.
+	 */
+	static constexpr uint64_t PREDICTABLE_MASK =
+	    (uint64_t(1) << 0) | (uint64_t(3) << 17) |
+	    (((uint64_t(1) << 39) - 1) << 20);
+
+	/**
+	 * Number of bits set in PREDICTABLE_MASK.
+	 */
+	static constexpr uint8_t PREDICTABLE_BITS = 42;
+
+	/**
+	 * Maximum difference in milliseconds between the start of the minute
+	 * observed by a decoder and the start of the minute stored in the cache.
+	 */
+	static constexpr uint16_t TOLERANCE = 100;
+
+private:
+	/**
+	 * Predicted bitstream.
+	 */
+	data m_expected;
+
+	/**
+	 * Bits of m_expected which are predicted, a subset of PREDICTABLE_MASK.
+	 */
+	uint64_t m_mask = 0;
+
+	/**
+	 * Timestamp at which the predicted frame starts.
+	 */
+	uint16_t m_phase = 0;
+
+public:
+	/**
+	 * Stores a completely valid frame and predicts the frame transmitted in
+	 * the following minute. No prediction is made if the hour ends with a
+	 * leap second or a change between CET and CEST. At the end of a day, the
+	 * date is not predicted.
+	 *
+	 * @param frame is the valid frame, i.e. the time at the given phase.
+	 * @param phase is the timestamp of the beginning of the minute described
+	 * by frame, which is also the beginning of the predicted frame.
+	 */
+	void confirm(const data &frame, uint16_t phase);
+
+	/**
+	 * Looks up the expected value of a bit.
+	 *
+	 * @param frame_start is the timestamp at which the frame containing the
+	 * bit started, as observed by the caller.
+	 * @param bit is the index of the bit within the frame.
+	 * @param value receives the expected value.
+	 * @return false if the bit is not predicted for the given frame.
+	 */
+	bool expect(uint16_t frame_start, uint8_t bit, bool &value) const
+	{
+		const uint16_t d = frame_start - m_phase;
+		if ((d > TOLERANCE && d < uint16_t(-TOLERANCE)) || bit >= 64 ||
+		    !((m_mask >> bit) & 1)) {
+			return false;
+		}
+		value = (m_expected.bitstream >> bit) & 1;
+		return true;
+	}
+
+	/**
+	 * Returns the predicted bitstream.
+	 */
+	const data &get_expected() const { return m_expected; }
+
+	/**
+	 * Returns the bits of get_expected() which are predicted.
+	 */
+	uint64_t get_mask() const { return m_mask; }
+
+	/**
+	 * Returns the timestamp at which the predicted frame starts.
+	 */
+	uint16_t get_phase() const { return m_phase; }
+};
+
 /**
  * The DCF77 decoder class allows to decode the DCF77 signal. It performs phase
  * recovery, input signal low-pass filtering with hysteresis and data
@@ -348,16 +781,109 @@ public:
 	     */
 		invalid_result = -1,
 
+		/**
+	     * The timestamp passed to sample() jumped backwards or forward by more
+	     * than the maximum gap. In the latter case, the bits received so far
+	     * were discarded and the decoder resynchronises to the signal.
+	     */
+		discontinuity = -2,
+
+		/**
+	     * The time of day has been received and is valid, but the date could
+	     * not be validated. Only the time fields of the data returned by
+	     * get_data() have been updated.
+	     */
+		has_time = 1,
+
 		/**
 	     * Time and date have been received and are valid, but supplementary
 	     * information is missing.
 	     */
-		has_time_and_date = 1,
+		has_time_and_date = 2,
 
 		/**
 	     * An entire dataset is available.
 	     */
-		has_complete = 2
+		has_complete = 3
+	};
+
+	/**
+	 * Value of second_info::second if the decoder is not synchronised to the
+	 * start of the minute.
+	 */
+	static constexpr uint8_t NO_SECOND = 0xFF;
+
+	/**
+	 * Describes the last received second, see get_last_second().
+	 */
+	struct second_info {
+		/**
+		 * Timestamp of the falling edge which started the second.
+		 */
+		uint16_t t = 0;
+
+		/**
+		 * Second within the minute, NO_SECOND if unknown.
+		 */
+		uint8_t second = NO_SECOND;
+
+		/**
+		 * Received bit.
+		 */
+		bool bit = false;
+
+		/**
+		 * Number of received seconds, wraps around. Changes whenever a new
+		 * second has been received.
+		 */
+		uint8_t count = 0;
+	};
+
+	/**
+	 * Flag set by classify_edges() if the pulse encodes a data bit.
+	 */
+	static constexpr uint8_t PULSE_BIT = 1;
+
+	/**
+	 * Flag set by classify_edges() if the pulse encodes a "one" bit.
+	 */
+	static constexpr uint8_t PULSE_ONE = 2;
+
+	/**
+	 * Flag set by classify_edges() if the pulse is a synchronisation gap.
+	 */
+	static constexpr uint8_t PULSE_SYNC = 4;
+
+	/**
+	 * Structure describing a frame found by assemble_frames().
+	 */
+	struct frame_candidate {
+		/**
+		 * Bits received before the synchronisation gap, aligned in the same
+		 * way as the decoder aligns incomplete data.
+		 */
+		data frame;
+
+		/**
+		 * Index of the edge terminating the synchronisation gap, i.e. the
+		 * falling edge marking the start of the next minute.
+		 */
+		size_t sync;
+
+		/**
+		 * Number of bits received before the synchronisation gap.
+		 */
+		uint8_t n_bits;
+
+		/**
+		 * Validation result, as it would be returned by sample().
+		 */
+		state result;
+
+		/**
+		 * Valid fields as returned by data::validate().
+		 */
+		uint8_t validity;
 	};
 
 private:
@@ -383,11 +909,21 @@ private:
 	 */
 	static constexpr uint16_t LOW_ONE_TIME = 200;
 
+	/**
+	 * Nominal time between the beginnings of two seconds.
+	 */
+	static constexpr uint16_t SECOND_TIME = 1000;
+
+	/**
+	 * Number of bits in a minute without leap second.
+	 */
+	static constexpr uint8_t FRAME_BITS = 59;
+
 	/**
 	 * Instance of the "debouncer" class used to software-filter the input
-	 * signal.
+	 * signal. The state type is selected by DCF77_DEBOUNCE_TYPE.
 	 */
-	debounce m_debouncer;
+	basic_debounce<DCF77_DEBOUNCE_TYPE> m_debouncer;
 
 	/**
 	 * Timestamp at which the falling edge corresponding to the start of the
@@ -417,7 +953,131 @@ private:
 	 */
 	uint8_t m_state = 0;
 
+	/**
+	 * Fields of m_data_current which were updated by the last valid frame.
+	 */
+	uint8_t m_validity = 0;
+
+	/**
+	 * Circular buffer containing the last FRAME_BITS received bits. Used to
+	 * find the start of a minute if the synchronisation gap was corrupted.
+	 */
+	uint64_t m_history = 0;
+
+	/**
+	 * Position in m_history at which the next bit is written.
+	 */
+	uint8_t m_history_pos = 0;
+
+	/**
+	 * Number of bits stored in m_history.
+	 */
+	uint8_t m_history_len = 0;
+
+	/**
+	 * True if m_state counts the bits since a known start of a minute.
+	 */
+	bool m_synced = false;
+
+#ifdef DCF77_FRAME_CACHE
+	/**
+	 * Number of bits of the current frame which matched the prediction of
+	 * m_cache.
+	 */
+	uint8_t m_n_verified = 0;
+#endif
+
+	/**
+	 * Timestamp of the rising edge which concluded the last received bit.
+	 */
+	uint16_t m_last_bit_t = 0;
+
+#ifdef DCF77_FRAME_CACHE
+	/**
+	 * Shared cache of the expected frame, nullptr if not used.
+	 */
+	frame_cache *m_cache = nullptr;
+
+	/**
+	 * Number of bits compared with the prediction of m_cache.
+	 */
+	uint32_t m_bits_checked = 0;
+
+	/**
+	 * Number of bits which differed from the prediction of m_cache.
+	 */
+	uint32_t m_bit_errors = 0;
+#endif
+
+	/**
+	 * Last received second.
+	 */
+	second_info m_second;
+
+	/**
+	 * Aligns the n_bits bits received before a synchronisation gap and
+	 * validates them.
+	 *
+	 * @param validity receives the result of data::validate().
+	 */
+	static state finish_frame(data &frame, uint8_t n_bits, uint8_t &validity);
+
+	/**
+	 * Concludes the frame in m_data_new. A complete frame whose predictable
+	 * bits all matched the frame cache is accepted without validation,
+	 * otherwise the frame is validated using finish_frame().
+	 */
+	state finish_current_frame(uint8_t &validity);
+
+	/**
+	 * Discards the bits of the current frame.
+	 */
+	void clear_frame();
+
+#ifdef DCF77_FRAME_CACHE
+	/**
+	 * Compares a received bit with the prediction of the frame cache and
+	 * updates the bit error counters.
+	 */
+	void verify_bit(uint8_t index, bool bit);
+#endif
+
+	/**
+	 * Copies the valid fields of m_data_new into m_data_current if the frame
+	 * contains at least a valid time.
+	 */
+	void publish(state res, uint8_t validity, uint16_t phase);
+
+	/**
+	 * Processes the output of the debounce filter for the sample at time t.
+	 */
+	state process(const debounce::result &event, uint16_t t);
+
+	/**
+	 * Appends a bit to the m_history circular buffer.
+	 */
+	void push_history(bool bit);
+
+	/**
+	 * Searches all rotations of m_history for the start of a minute. If a
+	 * unique start is found, m_data_new and m_state are set accordingly.
+	 *
+	 * @return true if the decoder is synchronised to the minute afterwards.
+	 */
+	bool align();
+
 public:
+	/**
+	 * Creates a new decoder.
+	 *
+	 * @param max_gap is the maximum time in milliseconds between two calls to
+	 * sample() which is treated as continuous input, see basic_debounce.
+	 */
+	decoder(uint16_t max_gap = debounce::MAX_GAP)
+	    : m_debouncer(debounce_traits<DCF77_DEBOUNCE_TYPE>::HYSTERESIS, max_gap)
+	{
+	}
+
 	/**
 	 * Pushes a new input sample into the decoder.
 	 *
@@ -433,6 +1093,36 @@ public:
 	 */
 	state sample(bool value, uint16_t t);
 
+	/**
+	 * Pushes a new analog input sample into the decoder. See
+	 * debounce::sample_amplitude() for more information.
+	 *
+	 * @param amplitude is the DCF77 carrier amplitude as measured by an
+	 * 8-bit analog to digital converter. Use sample_adc() for converters with
+	 * a different resolution.
+	 * @param t is a monotonously increasing timestamp in milliseconds.
+	 * @return the decoder state, see sample().
+	 */
+	state sample_amplitude(uint8_t amplitude, uint16_t t);
+
+	/**
+	 * Pushes the reading of an analog to digital converter with the given
+	 * resolution into the decoder. The reading is scaled to eight bits, i.e.
+	 * the eight most significant bits of a wider reading are used and a
+	 * narrower reading is shifted to the left.
+	 *
+	 * @param value is the right-aligned reading, for example 0 to 1023 for a
+	 * 10-bit converter.
+	 * @param bits is the resolution of the converter, 1 to 16.
+	 * @param t is a monotonously increasing timestamp in milliseconds.
+	 * @return the decoder state, see sample().
+	 */
+	state sample_adc(uint16_t value, uint8_t bits, uint16_t t)
+	{
+		return sample_amplitude(
+		    uint8_t(bits > 8 ? value >> (bits - 8) : value << (8 - bits)), t);
+	}
+
 	/**
 	 * Returns the timestamp at which the end of the last valid synchronisation
 	 * pulse was received.
@@ -440,8 +1130,89 @@ public:
 	uint16_t get_phase() const { return m_phase; }
 
 	/**
-	 * Returns a reference at the last validated time data.
+	 * Returns a reference at the last validated time data. Each field holds
+	 * the last value that passed validation.
 	 */
 	const data &get_data() const { return m_data_current; }
+
+	/**
+	 * Returns the fields updated by the last valid frame as a combination of
+	 * the data::VALID_MINUTE, data::VALID_HOUR, data::VALID_DATE and
+	 * data::VALID_FLAGS flags.
+	 */
+	uint8_t get_validity() const { return m_validity; }
+
+	/**
+	 * Returns the quality of the input signal during the last second.
+	 */
+	const debounce::quality &get_quality() const
+	{
+		return m_debouncer.get_quality();
+	}
+
+#ifdef DCF77_FRAME_CACHE
+	/**
+	 * Attaches the decoder to a frame cache shared with other decoders
+	 * receiving the same signal, see frame_cache.
+	 *
+	 * @param cache is the cache, nullptr detaches the decoder.
+	 */
+	void set_frame_cache(frame_cache *cache) { m_cache = cache; }
+
+	/**
+	 * Returns the number of received bits which were compared with the
+	 * prediction of the frame cache.
+	 */
+	uint32_t get_bits_checked() const { return m_bits_checked; }
+
+	/**
+	 * Returns the number of received bits which differed from the prediction
+	 * of the frame cache.
+	 */
+	uint32_t get_bit_errors() const { return m_bit_errors; }
+#endif
+
+	/**
+	 * Returns the second received last, including its bit and the timestamp
+	 * at which it started. Poll second_info::count after each call to
+	 * sample() to detect new seconds, for example to pass them to
+	 * telemetry_encoder::encode_second().
+	 */
+	const second_info &get_last_second() const { return m_second; }
+
+	/**
+	 * Classifies the time spans between n consecutive, alternating edges of an
+	 * already debounced input signal using the same criteria as sample().
+	 * Intended for the batch analysis of recorded edge timestamps.
+	 *
+	 * @param edges is an array of n edge timestamps.
+	 * @param pulses is an array of n - 1 entries which receives a combination
+	 * of the PULSE_BIT, PULSE_ONE and PULSE_SYNC flags for the time span
+	 * between edges[i] and edges[i + 1].
+	 * @param n is the number of edges.
+	 * @param first_falling must be true if edges[0] is a falling edge, i.e. the
+	 * start of a low carrier amplitude.
+	 */
+	static void classify_edges(const uint16_t *edges, uint8_t *pulses,
+	                           size_t n, bool first_falling);
+
+	/**
+	 * Packs the bits classified by classify_edges() into frames, one frame
+	 * per synchronisation gap.
+	 *
+	 * @param pulses is the output of classify_edges().
+	 * @param n is the number of entries in pulses.
+	 * @param frames is an array receiving the frame candidates.
+	 * @param max_frames is the number of entries in frames.
+	 * @return the number of frame candidates written to frames.
+	 */
+	static size_t assemble_frames(const uint8_t *pulses, size_t n,
+	                              frame_candidate *frames, size_t max_frames);
 };
 }
+
+#ifdef DCF77_HEADER_ONLY
+#include "dcf77.cpp"
+#endif
+
+#endif /* DCF77_HPP */
@@ -0,0 +1,341 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+
+#include "dcf77_analysis.hpp"
+
+namespace dcf77 {
+
+/******************************************************************************
+ * Class "availability"                                                       *
+ ******************************************************************************/
+
+availability::availability(outage *outages, size_t capacity)
+    : m_outages(outages), m_capacity(capacity)
+{
+	for (uint8_t i = 0; i < BINS; i++) {
+		m_valid[i] = 0;
+		m_total[i] = 0;
+	}
+}
+
+void availability::append_outage(const outage &o)
+{
+	if (m_n_outages > 0 && m_outages[m_n_outages - 1].end == o.begin) {
+		m_outages[m_n_outages - 1].end = o.end;
+	} else if (m_n_outages < m_capacity) {
+		m_outages[m_n_outages++] = o;
+	} else if (m_dropped < 0xFFFFFFFF) {
+		m_dropped++;
+	}
+}
+
+void availability::count(uint32_t t, bool valid)
+{
+	const uint8_t bin = (t % 86400) / BIN_SECONDS;
+	m_total[bin]++;
+	if (valid) {
+		m_valid[bin]++;
+	} else {
+		append_outage(outage{t, t + 60});
+	}
+}
+
+void availability::fill_gap(uint32_t t)
+{
+	if (t <= m_last + 60) {
+		return;
+	}
+
+	// Count whole bins at once, so long gaps do not require a loop over every
+	// single minute
+	uint32_t i = m_last + 60;
+	while (i < t) {
+		const uint32_t bin_end = i - i % BIN_SECONDS + BIN_SECONDS;
+		const uint32_t end = bin_end < t ? bin_end : t;
+		m_total[(i % 86400) / BIN_SECONDS] += (end - i) / 60;
+		i = end;
+	}
+	append_outage(outage{m_last + 60, t});
+}
+
+void availability::add(uint32_t t, bool valid)
+{
+	t -= t % 60;
+	if (m_empty) {
+		m_first = t;
+		m_empty = false;
+	} else if (t <= m_last) {
+		return;
+	} else {
+		fill_gap(t);
+	}
+	count(t, valid);
+	m_last = t;
+}
+
+bool availability::merge(const availability &later)
+{
+	if (later.m_empty) {
+		return true;
+	}
+	if (m_empty) {
+		m_first = later.m_first;
+		m_empty = false;
+	} else if (later.m_first <= m_last) {
+		return false;
+	} else {
+		fill_gap(later.m_first);
+	}
+	for (uint8_t i = 0; i < BINS; i++) {
+		m_valid[i] += later.m_valid[i];
+		m_total[i] += later.m_total[i];
+	}
+	for (size_t i = 0; i < later.m_n_outages; i++) {
+		append_outage(later.m_outages[i]);
+	}
+	const uint32_t dropped = m_dropped + later.m_dropped;
+	m_dropped = dropped < m_dropped ? 0xFFFFFFFF : dropped;
+	m_last = later.m_last;
+	return true;
+}
+
+uint32_t availability::ppm() const
+{
+	uint64_t valid = 0, total = 0;
+	for (uint8_t i = 0; i < BINS; i++) {
+		valid += m_valid[i];
+		total += m_total[i];
+	}
+	return total > 0 ? (valid * 1000000) / total : 0;
+}
+
+/******************************************************************************
+ * Class "latency_histogram"                                                  *
+ ******************************************************************************/
+
+void latency_histogram::reset()
+{
+	for (uint8_t i = 0; i < BUCKETS; i++) {
+		m_counts[i] = 0;
+	}
+	m_n = 0;
+	m_min = 0xFFFFFFFF;
+	m_max = 0;
+	m_sum = 0;
+}
+
+void latency_histogram::merge(const latency_histogram &other)
+{
+	for (uint8_t i = 0; i < BUCKETS; i++) {
+		m_counts[i] += other.m_counts[i];
+	}
+	m_n += other.m_n;
+	m_min = other.m_min < m_min ? other.m_min : m_min;
+	m_max = other.m_max > m_max ? other.m_max : m_max;
+	m_sum += other.m_sum;
+}
+
+uint32_t latency_histogram::quantile(uint16_t permille) const
+{
+	// Number of values below or at the quantile, rounded up
+	const uint64_t rank = (uint64_t(m_n) * permille + 999) / 1000;
+	uint64_t n = 0;
+	for (uint8_t i = 0; i < BUCKETS; i++) {
+		n += m_counts[i];
+		if (n >= rank && n > 0) {
+			const uint32_t v = bucket_max(i);
+			return v < m_max ? v : m_max;
+		}
+	}
+	return m_max;
+}
+
+/******************************************************************************
+ * Class "phase_evaluation"                                                   *
+ ******************************************************************************/
+
+/**
+ * Returns the k-th smallest of the n values, partially reordering them
+ * (quickselect).
+ */
+static int32_t nth_smallest(int32_t *v, size_t n, size_t k)
+{
+	ptrdiff_t lo = 0, hi = ptrdiff_t(n) - 1;
+	while (lo < hi) {
+		const int32_t pivot = v[lo + (hi - lo) / 2];
+		ptrdiff_t i = lo, j = hi;
+		while (i <= j) {
+			while (v[i] < pivot) {
+				i++;
+			}
+			while (v[j] > pivot) {
+				j--;
+			}
+			if (i <= j) {
+				const int32_t tmp = v[i];
+				v[i++] = v[j];
+				v[j--] = tmp;
+			}
+		}
+		if (ptrdiff_t(k) <= j) {
+			hi = j;
+		} else if (ptrdiff_t(k) >= i) {
+			lo = i;
+		} else {
+			break;
+		}
+	}
+	return v[k];
+}
+
+phase_evaluation::phase_evaluation(const int64_t *reference,
+                                   size_t n_reference, int32_t *errors,
+                                   int32_t *scratch, size_t capacity,
+                                   uint32_t window_us, uint32_t outlier_us)
+    : m_reference(reference),
+      m_n_reference(n_reference),
+      m_errors(errors),
+      m_scratch(scratch),
+      m_capacity(capacity),
+      m_window_us(window_us),
+      m_outlier_us(outlier_us)
+{
+	for (uint8_t k = 0; k < MTIE_POINTS; k++) {
+		m_mtie[k] = 0;
+	}
+}
+
+bool phase_evaluation::add(int64_t t_us)
+{
+	if (m_finished) {
+		return false;
+	}
+	if (m_n_reference == 0) {
+		m_unmatched++;
+		return false;
+	}
+
+	// Instants are added in ascending order, so the search continues where
+	// the last one ended
+	while (m_ref_pos + 1 < m_n_reference &&
+	       m_reference[m_ref_pos + 1] <= t_us) {
+		m_ref_pos++;
+	}
+	int64_t err = t_us - m_reference[m_ref_pos];
+	if (m_ref_pos + 1 < m_n_reference) {
+		// The following reference instant lies after t_us
+		const int64_t next = m_reference[m_ref_pos + 1] - t_us;
+		if (next < (err < 0 ? -err : err)) {
+			err = -next;
+		}
+	}
+	if (err > int64_t(m_window_us) || err < -int64_t(m_window_us)) {
+		m_unmatched++;
+		return false;
+	}
+	if (m_n_errors < m_capacity) {
+		m_errors[m_n_errors++] = int32_t(err);
+	} else {
+		m_dropped++;
+	}
+	return true;
+}
+
+void phase_evaluation::finish()
+{
+	if (m_finished) {
+		return;
+	}
+	m_finished = true;
+
+	// Outliers are determined relative to the median, which, unlike the mean,
+	// is not shifted by the outliers themselves
+	for (size_t i = 0; i < m_n_errors; i++) {
+		m_scratch[i] = m_errors[i];
+	}
+	const size_t n_errors = m_n_errors;
+	const int64_t median =
+	    n_errors > 0 ? nth_smallest(m_scratch, n_errors, n_errors / 2) : 0;
+	for (size_t i = 0; i < m_n_errors; i++) {
+		const int64_t d = m_errors[i] - median;
+		if (d > int64_t(m_outlier_us) || d < -int64_t(m_outlier_us)) {
+			m_outliers++;
+		} else {
+			m_n++;
+			m_sum += m_errors[i];
+			m_sum_sq += uint64_t(int64_t(m_errors[i]) * m_errors[i]);
+		}
+	}
+
+	// Compute the maximum and minimum over windows of 2^k errors from those
+	// over windows of 2^(k - 1) errors. Ascending indices allow doing this in
+	// place.
+	int32_t *max = m_errors, *min = m_scratch;
+	for (size_t i = 0; i < m_n_errors; i++) {
+		min[i] = max[i];
+	}
+	size_t n = m_n_errors;
+	m_mtie_points = n > 0 ? 1 : 0;
+	for (uint8_t k = 1; k < MTIE_POINTS; k++) {
+		const size_t half = size_t(1) << (k - 1);
+		if (n <= half) {
+			break;
+		}
+		n -= half;
+		uint32_t mtie = 0;
+		for (size_t i = 0; i < n; i++) {
+			max[i] = max[i + half] > max[i] ? max[i + half] : max[i];
+			min[i] = min[i + half] < min[i] ? min[i + half] : min[i];
+			const uint32_t d = uint32_t(max[i] - min[i]);
+			mtie = d > mtie ? d : mtie;
+		}
+		m_mtie[k] = mtie;
+		m_mtie_points = k + 1;
+	}
+	m_n_errors = 0;
+	m_capacity = 0;
+}
+
+void phase_evaluation::merge(const phase_evaluation &other)
+{
+	m_unmatched += other.m_unmatched;
+	m_dropped += other.m_dropped;
+	m_n += other.m_n;
+	m_sum += other.m_sum;
+	m_sum_sq += other.m_sum_sq;
+	m_outliers += other.m_outliers;
+	for (uint8_t k = 0; k < other.m_mtie_points; k++) {
+		m_mtie[k] = other.m_mtie[k] > m_mtie[k] ? other.m_mtie[k] : m_mtie[k];
+	}
+	if (other.m_mtie_points > m_mtie_points) {
+		m_mtie_points = other.m_mtie_points;
+	}
+}
+
+uint32_t phase_evaluation::jitter_us() const
+{
+	if (m_n < 2) {
+		return 0;
+	}
+	const double mean = double(m_sum) / m_n;
+	const double var = double(m_sum_sq) / m_n - mean * mean;
+	return var > 0.0 ? uint32_t(sqrt(var)) : 0;
+}
+}
@@ -0,0 +1,519 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dcf77_analysis.hpp
+ *
+ * Analysis of decoder results and of the applications built around the
+ * decoder. The aggregates defined here never allocate memory and can be
+ * merged, so large archives can be split into contiguous time ranges, and
+ * collections of captures into single captures, which are processed by
+ * independent threads.
+ *
+ * @author Andreas Stöckel
+ */
+
+#ifndef DCF77_ANALYSIS_HPP
+#define DCF77_ANALYSIS_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace dcf77 {
+
+/**
+ * Interval during which no valid frame was received.
+ */
+struct outage {
+	/**
+	 * Beginning of the first minute without valid frame in seconds since
+	 * 1970-01-01 00:00:00 UTC.
+	 */
+	uint32_t begin;
+
+	/**
+	 * End of the last minute without valid frame (exclusive).
+	 */
+	uint32_t end;
+};
+
+/**
+ * Aggregates the reception availability of a single receiver: the fraction
+ * of minutes with a valid frame per time of day and a list of outage
+ * intervals. Minutes must be added in chronological order. Minutes missing
+ * between two consecutive calls to add() count as minutes without valid
+ * frame.
+ *
+ * To process an archive in parallel, split it into contiguous time ranges,
+ * process each range with its own instance and merge the instances in
+ * chronological order.
+ */
+class availability {
+public:
+	/**
+	 * Number of time of day bins (quarter hours, UTC).
+	 */
+	static constexpr uint8_t BINS = 96;
+
+	/**
+	 * Length of a bin in seconds.
+	 */
+	static constexpr uint16_t BIN_SECONDS = 86400 / BINS;
+
+private:
+	/**
+	 * Number of minutes with a valid frame per bin.
+	 */
+	uint32_t m_valid[BINS];
+
+	/**
+	 * Total number of minutes per bin.
+	 */
+	uint32_t m_total[BINS];
+
+	/**
+	 * Buffer provided by the caller.
+	 */
+	outage *m_outages;
+
+	/**
+	 * Number of entries which fit into m_outages.
+	 */
+	size_t m_capacity;
+
+	/**
+	 * Number of entries stored in m_outages.
+	 */
+	size_t m_n_outages = 0;
+
+	/**
+	 * Number of outages which did not fit into the buffer.
+	 */
+	uint32_t m_dropped = 0;
+
+	/**
+	 * First minute added to this instance.
+	 */
+	uint32_t m_first = 0;
+
+	/**
+	 * Last minute added to this instance.
+	 */
+	uint32_t m_last = 0;
+
+	/**
+	 * True if no minute has been added yet.
+	 */
+	bool m_empty = true;
+
+	/**
+	 * Counts a single minute.
+	 */
+	void count(uint32_t t, bool valid);
+
+	/**
+	 * Appends an outage, joins it with the last outage if they are adjacent.
+	 */
+	void append_outage(const outage &o);
+
+	/**
+	 * Counts the minutes between m_last and t (both exclusive) as invalid.
+	 */
+	void fill_gap(uint32_t t);
+
+public:
+	/**
+	 * Creates an empty aggregate.
+	 *
+	 * @param outages is a buffer receiving the outage intervals.
+	 * @param capacity is the number of outages which fit into the buffer.
+	 */
+	availability(outage *outages, size_t capacity);
+
+	/**
+	 * Adds a minute to the aggregate. Minutes before or equal to the last
+	 * added minute are ignored.
+	 *
+	 * @param t is a timestamp within the minute in seconds since 1970-01-01
+	 * 00:00:00 UTC, for example the result of data::unix_time().
+	 * @param valid should be true if a valid frame was received for this
+	 * minute, for example if the decoder returned has_time or better.
+	 */
+	void add(uint32_t t, bool valid);
+
+	/**
+	 * Merges the aggregate of a later time range into this one. Minutes
+	 * between both ranges count as minutes without valid frame.
+	 *
+	 * @return false if the other aggregate does not lie after this one, in
+	 * which case this aggregate is not modified.
+	 */
+	bool merge(const availability &later);
+
+	/**
+	 * Returns the number of minutes with a valid frame in the given bin.
+	 */
+	uint32_t valid(uint8_t bin) const { return m_valid[bin]; }
+
+	/**
+	 * Returns the total number of minutes in the given bin.
+	 */
+	uint32_t total(uint8_t bin) const { return m_total[bin]; }
+
+	/**
+	 * Returns the availability over all bins in parts per million.
+	 */
+	uint32_t ppm() const;
+
+	/**
+	 * Returns the recorded outages in chronological order.
+	 */
+	const outage *outages() const { return m_outages; }
+
+	/**
+	 * Returns the number of recorded outages.
+	 */
+	size_t n_outages() const { return m_n_outages; }
+
+	/**
+	 * Returns the number of outages which were not recorded because the
+	 * buffer was full.
+	 */
+	uint32_t dropped_outages() const { return m_dropped; }
+};
+
+/**
+ * Histogram of latencies with logarithmic buckets, intended for tracing the
+ * time between the capture of an edge and the delivery of the result. Bucket
+ * zero counts the value zero, bucket k > 0 counts values from 2^(k - 1) to
+ * 2^k - 1. The unit of the values is chosen by the caller.
+ *
+ * For a breakdown by processing stage, keep one histogram per stage and add
+ * the time between the capture timestamp and the end of the stage. The
+ * latency of the decoder itself is the time between get_phase() and the call
+ * to sample() which returned the result. Histograms of different threads or
+ * time ranges can be merged in any order.
+ */
+class latency_histogram {
+public:
+	/**
+	 * Number of buckets.
+	 */
+	static constexpr uint8_t BUCKETS = 33;
+
+private:
+	/**
+	 * Number of values per bucket.
+	 */
+	uint32_t m_counts[BUCKETS];
+
+	/**
+	 * Total number of values.
+	 */
+	uint32_t m_n;
+
+	/**
+	 * Smallest and largest value.
+	 */
+	uint32_t m_min, m_max;
+
+	/**
+	 * Sum of all values.
+	 */
+	uint64_t m_sum;
+
+public:
+	/**
+	 * Creates an empty histogram.
+	 */
+	latency_histogram() { reset(); }
+
+	/**
+	 * Removes all values.
+	 */
+	void reset();
+
+	/**
+	 * Returns the bucket a value is counted in.
+	 */
+	static uint8_t bucket(uint32_t value)
+	{
+		return value == 0 ? 0 : 32 - __builtin_clz(value);
+	}
+
+	/**
+	 * Returns the smallest value counted in the given bucket.
+	 */
+	static uint32_t bucket_min(uint8_t b)
+	{
+		return b == 0 ? 0 : uint32_t(1) << (b - 1);
+	}
+
+	/**
+	 * Returns the largest value counted in the given bucket.
+	 */
+	static uint32_t bucket_max(uint8_t b)
+	{
+		return b == 0 ? 0 : (uint32_t(2) << (b - 1)) - 1;
+	}
+
+	/**
+	 * Adds a value.
+	 */
+	void add(uint32_t value)
+	{
+		m_counts[bucket(value)]++;
+		m_n++;
+		m_min = value < m_min ? value : m_min;
+		m_max = value > m_max ? value : m_max;
+		m_sum += value;
+	}
+
+	/**
+	 * Adds the values of another histogram.
+	 */
+	void merge(const latency_histogram &other);
+
+	/**
+	 * Returns the number of values in the given bucket.
+	 */
+	uint32_t count(uint8_t b) const { return m_counts[b]; }
+
+	/**
+	 * Returns the total number of values.
+	 */
+	uint32_t n() const { return m_n; }
+
+	/**
+	 * Returns the smallest value, zero if the histogram is empty.
+	 */
+	uint32_t min() const { return m_n > 0 ? m_min : 0; }
+
+	/**
+	 * Returns the largest value.
+	 */
+	uint32_t max() const { return m_max; }
+
+	/**
+	 * Returns the mean value, zero if the histogram is empty.
+	 */
+	uint32_t mean() const { return m_n > 0 ? m_sum / m_n : 0; }
+
+	/**
+	 * Returns an upper bound of the given quantile: the largest value of the
+	 * bucket containing the quantile, limited to max().
+	 *
+	 * @param permille is the quantile in parts per thousand, for example 990
+	 * for the 99th percentile.
+	 */
+	uint32_t quantile(uint16_t permille) const;
+};
+
+/**
+ * Compares instants measured by the decoder with reference instants, for
+ * example the minute starts returned by get_phase() or the falling edges of
+ * each second with the pulses of a GPS receiver recorded alongside a capture.
+ * Both must be given in microseconds on a common timeline. Each measured
+ * instant is matched with the nearest reference instant; the differences are
+ * summarised as bias, jitter and outlier count, and as maximum time interval
+ * error (MTIE) over windows of 2^k consecutive matched instants.
+ *
+ * Call add() for each measured instant, then finish(). Finished
+ * evaluations of different captures can be merged in any order, so captures
+ * can be evaluated by independent threads, each with its own buffers.
+ */
+class phase_evaluation {
+public:
+	/**
+	 * Number of MTIE window sizes.
+	 */
+	static constexpr uint8_t MTIE_POINTS = 24;
+
+private:
+	/**
+	 * Reference instants provided by the caller, in ascending order.
+	 */
+	const int64_t *m_reference;
+
+	/**
+	 * Number of reference instants.
+	 */
+	size_t m_n_reference;
+
+	/**
+	 * Index of the last reference instant not after the last measured
+	 * instant.
+	 */
+	size_t m_ref_pos = 0;
+
+	/**
+	 * Buffers provided by the caller. m_errors receives the time errors of
+	 * the matched instants, m_scratch is used by finish().
+	 */
+	int32_t *m_errors, *m_scratch;
+
+	/**
+	 * Number of entries which fit into each buffer.
+	 */
+	size_t m_capacity;
+
+	/**
+	 * Number of entries stored in m_errors.
+	 */
+	size_t m_n_errors = 0;
+
+	/**
+	 * Maximum distance between a measured instant and its reference instant.
+	 */
+	uint32_t m_window_us;
+
+	/**
+	 * Maximum distance between a time error and the bias for the error not
+	 * to be counted as outlier.
+	 */
+	uint32_t m_outlier_us;
+
+	/**
+	 * Number of measured instants without reference instant within the
+	 * window.
+	 */
+	uint32_t m_unmatched = 0;
+
+	/**
+	 * Number of matched instants which did not fit into the buffer.
+	 */
+	uint32_t m_dropped = 0;
+
+	/**
+	 * Number of errors within the outlier bound, their sum and sum of
+	 * squares.
+	 */
+	uint32_t m_n = 0;
+	int64_t m_sum = 0;
+	uint64_t m_sum_sq = 0;
+
+	/**
+	 * Number of outliers.
+	 */
+	uint32_t m_outliers = 0;
+
+	/**
+	 * MTIE per window size, valid up to m_mtie_points.
+	 */
+	uint32_t m_mtie[MTIE_POINTS];
+
+	/**
+	 * Number of window sizes covered by the matched instants.
+	 */
+	uint8_t m_mtie_points = 0;
+
+	/**
+	 * Set by finish().
+	 */
+	bool m_finished = false;
+
+public:
+	/**
+	 * Creates an empty evaluation.
+	 *
+	 * @param reference is the list of reference instants in microseconds in
+	 * ascending order.
+	 * @param n_reference is the number of reference instants.
+	 * @param errors and scratch are buffers of capacity entries each.
+	 * @param window_us is the maximum distance between a measured instant and
+	 * the nearest reference instant. Should be less than half the distance
+	 * between reference instants.
+	 * @param outlier_us is the maximum distance between a time error and the
+	 * median error for the error to be included in the bias and jitter.
+	 */
+	phase_evaluation(const int64_t *reference, size_t n_reference,
+	                 int32_t *errors, int32_t *scratch, size_t capacity,
+	                 uint32_t window_us = 400000, uint32_t outlier_us = 20000);
+
+	/**
+	 * Matches a measured instant with the nearest reference instant. Measured
+	 * instants must be added in ascending order.
+	 *
+	 * @param t_us is the measured instant in microseconds.
+	 * @return false if no reference instant lies within the window or
+	 * finish() has already been called.
+	 */
+	bool add(int64_t t_us);
+
+	/**
+	 * Computes bias, jitter, outliers and MTIE from the matched instants.
+	 * Errors further than the outlier bound from the median error are
+	 * outliers. Overwrites both buffers; further calls to add() and finish()
+	 * have no effect.
+	 */
+	void finish();
+
+	/**
+	 * Merges the results of another finished evaluation. The MTIE of the
+	 * merged evaluation is the maximum of both.
+	 */
+	void merge(const phase_evaluation &other);
+
+	/**
+	 * Returns the number of matched instants within the outlier bound.
+	 */
+	uint32_t n() const { return m_n; }
+
+	/**
+	 * Returns the number of matched instants outside the outlier bound.
+	 */
+	uint32_t outliers() const { return m_outliers; }
+
+	/**
+	 * Returns the number of measured instants which could not be matched.
+	 */
+	uint32_t unmatched() const { return m_unmatched; }
+
+	/**
+	 * Returns the number of matched instants which were not evaluated because
+	 * the buffers were full.
+	 */
+	uint32_t dropped() const { return m_dropped; }
+
+	/**
+	 * Returns the mean time error in microseconds, excluding outliers. A
+	 * positive value means that the measured instants are late.
+	 */
+	int32_t bias_us() const { return m_n > 0 ? m_sum / int64_t(m_n) : 0; }
+
+	/**
+	 * Returns the standard deviation of the time error in microseconds,
+	 * excluding outliers.
+	 */
+	uint32_t jitter_us() const;
+
+	/**
+	 * Returns the number of window sizes for which mtie_us() is defined.
+	 */
+	uint8_t mtie_points() const { return m_mtie_points; }
+
+	/**
+	 * Returns the MTIE in microseconds: the largest difference between two
+	 * time errors within any window of 2^k consecutive matched instants,
+	 * including outliers.
+	 */
+	uint32_t mtie_us(uint8_t k) const { return m_mtie[k]; }
+};
+}
+
+#endif /* DCF77_ANALYSIS_HPP */
@@ -0,0 +1,93 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dcf77_backfill.hpp"
+
+namespace dcf77 {
+
+/******************************************************************************
+ * Class "backfill"                                                           *
+ ******************************************************************************/
+
+bool backfill::record(uint16_t tag, uint16_t t)
+{
+	const uint32_t ext_t = update(t);
+	if (m_count >= m_capacity) {
+		if (m_overflows < 0xFFFF) {
+			m_overflows++;
+		}
+		return false;
+	}
+	size_t idx = m_head + m_count;
+	if (idx >= m_capacity) {
+		idx -= m_capacity;
+	}
+	m_buf[idx].t = ext_t;
+	m_buf[idx].tag = tag;
+	m_count++;
+	return true;
+}
+
+bool backfill::anchor(const decoder &dec, decoder::state res, uint16_t t)
+{
+	const uint32_t ext_t = update(t);
+	// The UTC offset is derived from the CEST flag, which is not valid in
+	// frames received only partially
+	if (res < decoder::state::has_time_and_date ||
+	    (dec.get_validity() & data::VALID_ALL) != data::VALID_ALL) {
+		return false;
+	}
+
+	// The phase is the local timestamp of the beginning of the minute encoded
+	// in the frame, received just now. Extend it relative to the current
+	// time.
+	m_anchor_t = ext_t - uint16_t(t - dec.get_phase());
+	m_anchor_time = dec.get_data().unix_time();
+	m_anchored = true;
+	return true;
+}
+
+size_t backfill::resolve(resolved *out, size_t n_out)
+{
+	if (!m_anchored) {
+		return 0;
+	}
+
+	size_t n = 0;
+	while (n < n_out && m_count > 0) {
+		const event &e = m_buf[m_head];
+		const int32_t dt = int32_t(e.t - m_anchor_t);
+		resolved &r = out[n++];
+		if (dt >= 0) {
+			r.unix_time = m_anchor_time + uint32_t(dt) / 1000;
+			r.ms = uint32_t(dt) % 1000;
+		} else {
+			const uint32_t ndt = uint32_t(-dt) + 999;
+			r.unix_time = m_anchor_time - ndt / 1000;
+			r.ms = 999 - ndt % 1000;
+		}
+		r.tag = e.tag;
+
+		if (++m_head >= m_capacity) {
+			m_head = 0;
+		}
+		m_count--;
+	}
+	return n;
+}
+}
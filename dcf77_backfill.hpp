@@ -0,0 +1,218 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dcf77_backfill.hpp
+ *
+ * Retroactive timestamping of events recorded before the decoder has received
+ * the first valid time and date. Events are stored with the local millisecond
+ * counter and later resolved to UTC using the phase reported by the decoder.
+ *
+ * @author Andreas Stöckel
+ */
+
+#ifndef DCF77_BACKFILL_HPP
+#define DCF77_BACKFILL_HPP
+
+#include "dcf77.hpp"
+
+namespace dcf77 {
+
+/**
+ * The backfill class stores events tagged with the local timestamp in a
+ * circular buffer provided by the caller. The 16-bit timestamps passed to the
+ * decoder wrap around after about 65 seconds, so the class extends them to
+ * 32 bits. For this to work, either record(), update() or anchor() must be
+ * called at least once every 32 seconds, for example by calling anchor()
+ * with the result of each call to decoder::sample().
+ */
+class backfill {
+public:
+	/**
+	 * Event stored in the buffer.
+	 */
+	struct event {
+		/**
+		 * Extended local timestamp in milliseconds.
+		 */
+		uint32_t t;
+
+		/**
+		 * User-defined event identifier.
+		 */
+		uint16_t tag;
+	};
+
+	/**
+	 * Event resolved to absolute time.
+	 */
+	struct resolved {
+		/**
+		 * Seconds since 1970-01-01 00:00:00 UTC.
+		 */
+		uint32_t unix_time;
+
+		/**
+		 * Milliseconds within the second.
+		 */
+		uint16_t ms;
+
+		/**
+		 * User-defined event identifier.
+		 */
+		uint16_t tag;
+	};
+
+private:
+	/**
+	 * Buffer provided by the caller.
+	 */
+	event *m_buf;
+
+	/**
+	 * Number of events which fit into m_buf.
+	 */
+	size_t m_capacity;
+
+	/**
+	 * Index of the oldest event in m_buf.
+	 */
+	size_t m_head = 0;
+
+	/**
+	 * Number of events stored in m_buf.
+	 */
+	size_t m_count = 0;
+
+	/**
+	 * Number of events discarded because the buffer was full.
+	 */
+	uint16_t m_overflows = 0;
+
+	/**
+	 * Extended timestamp corresponding to m_last_t.
+	 */
+	uint32_t m_ext_t = 0;
+
+	/**
+	 * Last 16-bit timestamp passed to update().
+	 */
+	uint16_t m_last_t = 0;
+
+	/**
+	 * Extended timestamp of the beginning of the minute described by the
+	 * last frame with a valid time, date and UTC offset.
+	 */
+	uint32_t m_anchor_t = 0;
+
+	/**
+	 * Time of this minute in seconds since 1970-01-01 00:00:00 UTC.
+	 */
+	uint32_t m_anchor_time = 0;
+
+	/**
+	 * True once a frame with a valid time, date and UTC offset has been
+	 * received.
+	 */
+	bool m_anchored = false;
+
+public:
+	/**
+	 * Creates a new backfill instance.
+	 *
+	 * @param buf is a buffer for capacity events. Each event requires six to
+	 * eight bytes of RAM, depending on the platform.
+	 * @param capacity is the number of events that can be stored.
+	 * @param t is the current timestamp.
+	 */
+	backfill(event *buf, size_t capacity, uint16_t t = 0)
+	    : m_buf(buf), m_capacity(capacity), m_last_t(t)
+	{
+	}
+
+	/**
+	 * Advances the extended timestamp. Timestamps up to 32 seconds before the
+	 * last one passed to update() are extended without moving it back, so
+	 * events captured in an interrupt may be recorded after later timestamps
+	 * were passed to anchor().
+	 *
+	 * @param t is the current timestamp in milliseconds, as passed to
+	 * decoder::sample().
+	 * @return the extended timestamp.
+	 */
+	uint32_t update(uint16_t t)
+	{
+		const uint16_t dt = t - m_last_t;
+		if (int16_t(dt) < 0) {
+			return m_ext_t - uint16_t(m_last_t - t);
+		}
+		m_ext_t += dt;
+		m_last_t = t;
+		return m_ext_t;
+	}
+
+	/**
+	 * Stores an event. If the buffer is full, the event is discarded and the
+	 * overflow counter is incremented.
+	 *
+	 * @param tag is a user-defined event identifier.
+	 * @param t is the timestamp at which the event occurred.
+	 * @return false if the event had to be discarded.
+	 */
+	bool record(uint16_t tag, uint16_t t);
+
+	/**
+	 * Records the time and phase of the frame just published by the decoder
+	 * as reference for resolve(). The phase is extended while it is recent,
+	 * so the reference stays valid after further wrap-arounds.
+	 *
+	 * @param dec is the decoder.
+	 * @param res is the result of the last call to decoder::sample(). Only
+	 * frames whose time, date and flags are all valid update the reference,
+	 * since the flags determine the UTC offset.
+	 * @param t is the timestamp passed to this call.
+	 * @return true if the reference was updated.
+	 */
+	bool anchor(const decoder &dec, decoder::state res, uint16_t t);
+
+	/**
+	 * Resolves the oldest stored events to absolute time and removes them from
+	 * the buffer. Should be called once anchor() has returned true,
+	 * repeatedly until it returns zero.
+	 *
+	 * @param out is the array to which the resolved events are written.
+	 * @param n_out is the size of the output array.
+	 * @return the number of events written to out. Zero if anchor() has not
+	 * returned true yet.
+	 */
+	size_t resolve(resolved *out, size_t n_out);
+
+	/**
+	 * Returns the number of events waiting to be resolved.
+	 */
+	size_t pending() const { return m_count; }
+
+	/**
+	 * Returns the number of events that were discarded because the buffer was
+	 * full.
+	 */
+	uint16_t get_overflows() const { return m_overflows; }
+};
+}
+
+#endif /* DCF77_BACKFILL_HPP */
@@ -0,0 +1,220 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dcf77_capture.hpp"
+
+namespace dcf77 {
+
+/******************************************************************************
+ * Helper functions                                                           *
+ ******************************************************************************/
+
+static constexpr uint16_t CAPTURE_MAGIC = 0x77DC;
+
+static void write_header(uint8_t *p, bool value, uint16_t len, uint32_t t)
+{
+	p[0] = CAPTURE_MAGIC & 0xFF;
+	p[1] = CAPTURE_MAGIC >> 8;
+	p[2] = value ? 1 : 0;
+	p[3] = len & 0xFF;
+	p[4] = len >> 8;
+	for (uint8_t i = 0; i < 4; i++) {
+		p[5 + i] = (t >> (8 * i)) & 0xFF;
+	}
+}
+
+/******************************************************************************
+ * Class "file_block_device"                                                  *
+ ******************************************************************************/
+
+#ifdef DCF77_HAS_STDIO
+file_block_device::file_block_device(const char *filename, size_t block_size,
+                                     uint32_t n_blocks)
+    : m_block_size(block_size), m_n_blocks(n_blocks)
+{
+	m_file = fopen(filename, "r+b");
+	if (!m_file) {
+		m_file = fopen(filename, "w+b");
+	}
+}
+
+file_block_device::~file_block_device()
+{
+	if (m_file) {
+		fclose(m_file);
+	}
+}
+
+bool file_block_device::read(uint32_t block, uint8_t *buf)
+{
+	if (!m_file || block >= m_n_blocks ||
+	    fseek(m_file, long(block) * long(m_block_size), SEEK_SET) != 0) {
+		return false;
+	}
+	return fread(buf, 1, m_block_size, m_file) == m_block_size;
+}
+
+bool file_block_device::write(uint32_t block, const uint8_t *buf)
+{
+	if (!m_file || block >= m_n_blocks ||
+	    fseek(m_file, long(block) * long(m_block_size), SEEK_SET) != 0) {
+		return false;
+	}
+	return fwrite(buf, 1, m_block_size, m_file) == m_block_size &&
+	       fflush(m_file) == 0;
+}
+#endif
+
+/******************************************************************************
+ * Class "edge_logger"                                                        *
+ ******************************************************************************/
+
+edge_logger::edge_logger(block_device &dev, uint8_t *page, bool value,
+                         uint16_t t)
+    : m_dev(dev), m_page(page), m_t(0), m_run_start(0), m_last_t(t),
+      m_value(value)
+{
+	start_page();
+}
+
+void edge_logger::start_page()
+{
+	// The header is written once the page is complete
+	m_page_start = m_run_start;
+	m_page_value = m_value;
+	m_len = CAPTURE_HEADER_SIZE;
+}
+
+bool edge_logger::flush()
+{
+	if (m_stopped) {
+		return false;
+	}
+	write_header(m_page, m_page_value, m_len, m_page_start);
+	for (size_t i = m_len; i < m_dev.block_size(); i++) {
+		m_page[i] = 0;
+	}
+	if (m_block >= m_dev.n_blocks() || !m_dev.write(m_block, m_page)) {
+		m_stopped = true;
+		return false;
+	}
+	m_block++;
+	start_page();
+	return true;
+}
+
+void edge_logger::edge(bool value)
+{
+	// Encode the length of the run which just ended
+	uint8_t buf[5];
+	uint8_t n = 0;
+	uint32_t run = m_t - m_run_start;
+	do {
+		buf[n] = run & 0x7F;
+		run >>= 7;
+		if (run) {
+			buf[n] |= 0x80;
+		}
+		n++;
+	} while (run);
+
+	// Start a new page if the run does not fit into the current one
+	if (m_len + n > m_dev.block_size()) {
+		flush();
+	}
+	if (m_stopped) {
+		m_dropped++;
+	} else {
+		for (uint8_t i = 0; i < n; i++) {
+			m_page[m_len++] = buf[i];
+		}
+	}
+	m_run_start = m_t;
+	m_value = value;
+}
+
+/******************************************************************************
+ * Class "capture_reader"                                                     *
+ ******************************************************************************/
+
+capture_reader::capture_reader(block_device &dev, uint8_t *page)
+    : m_dev(dev), m_page(page)
+{
+	load_page();
+}
+
+bool capture_reader::load_page()
+{
+	if (m_block >= m_dev.n_blocks() || !m_dev.read(m_block, m_page)) {
+		return false;
+	}
+
+	// Check the header
+	const uint8_t *p = m_page;
+	const uint16_t magic = p[0] | (p[1] << 8);
+	const uint16_t len = p[3] | (p[4] << 8);
+	const bool value = p[2] & 1;
+	const uint32_t t = p[5] | (p[6] << 8) | (uint32_t(p[7]) << 16) |
+	                   (uint32_t(p[8]) << 24);
+	if (magic != CAPTURE_MAGIC || p[2] > 1 || len < CAPTURE_HEADER_SIZE ||
+	    len > m_dev.block_size()) {
+		return false;
+	}
+
+	// Subsequent pages must continue the previous one
+	if (m_block > 0 && (t != m_t || value != m_value)) {
+		return false;
+	}
+	m_t = t;
+	m_value = value;
+	m_pos = CAPTURE_HEADER_SIZE;
+	m_len = len;
+	m_block++;
+	return true;
+}
+
+bool capture_reader::next(capture_edge &e)
+{
+	while (m_pos >= m_len) {
+		if (!load_page()) {
+			return false;
+		}
+	}
+
+	// Decode the run length
+	uint32_t run = 0;
+	uint8_t shift = 0;
+	while (true) {
+		if (m_pos >= m_len || shift > 28) {
+			m_len = 0; // Corrupted page, end of capture
+			return false;
+		}
+		const uint8_t b = m_page[m_pos++];
+		run |= uint32_t(b & 0x7F) << shift;
+		shift += 7;
+		if (!(b & 0x80)) {
+			break;
+		}
+	}
+	m_t += run;
+	m_value = !m_value;
+	e.t = m_t;
+	e.value = m_value;
+	return true;
+}
+}
@@ -0,0 +1,363 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dcf77_capture.hpp
+ *
+ * Capture of the raw receiver signal for field debugging. The signal is
+ * stored as run lengths between edges, which requires about eight bytes per
+ * second of input instead of one bit per millisecond.
+ *
+ * Capture format: the capture consists of pages of equal size stored in
+ * consecutive blocks of a block device. Each page starts with a header of
+ * CAPTURE_HEADER_SIZE bytes, all values are little-endian:
+ *
+ *   offset 0: magic number 0x77DC (2 bytes)
+ *   offset 2: input level at the beginning of the page, zero or one (1 byte)
+ *   offset 3: number of used bytes including the header (2 bytes)
+ *   offset 5: timestamp in milliseconds at which the input changed to the
+ *             given level (4 bytes)
+ *
+ * The header is followed by the run lengths in milliseconds, each encoded as
+ * unsigned LEB128 variable length integer (seven bits per byte, least
+ * significant group first, bit 7 set in all but the last byte). After each
+ * run, the input level toggles. The timestamp and level of each page continue
+ * the previous page; a page which does not continue it marks the end of the
+ * capture.
+ *
+ * @author Andreas Stöckel
+ */
+
+#ifndef DCF77_CAPTURE_HPP
+#define DCF77_CAPTURE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__unix__) || defined(__APPLE__) || defined(_WIN32)
+#include <stdio.h>
+#define DCF77_HAS_STDIO
+#endif
+
+namespace dcf77 {
+
+/**
+ * Minimal interface of a storage device organised in blocks of equal size,
+ * such as SPI flash or an SD card.
+ */
+class block_device {
+public:
+	virtual ~block_device() {}
+
+	/**
+	 * Returns the size of a block in bytes.
+	 */
+	virtual size_t block_size() const = 0;
+
+	/**
+	 * Returns the number of blocks.
+	 */
+	virtual uint32_t n_blocks() const = 0;
+
+	/**
+	 * Reads the block with the given index into buf.
+	 *
+	 * @return false on error.
+	 */
+	virtual bool read(uint32_t block, uint8_t *buf) = 0;
+
+	/**
+	 * Writes buf to the block with the given index. Erasing the block, if
+	 * required, is the responsibility of the implementation.
+	 *
+	 * @return false on error.
+	 */
+	virtual bool write(uint32_t block, const uint8_t *buf) = 0;
+};
+
+#ifdef DCF77_HAS_STDIO
+/**
+ * Block device backed by a file, intended for testing on hosts and for
+ * reading images of captures copied from a device.
+ */
+class file_block_device : public block_device {
+private:
+	/**
+	 * File handle, nullptr if the file could not be opened.
+	 */
+	FILE *m_file;
+
+	/**
+	 * Size of a block in bytes.
+	 */
+	size_t m_block_size;
+
+	/**
+	 * Number of blocks.
+	 */
+	uint32_t m_n_blocks;
+
+public:
+	/**
+	 * Opens the given file. An existing file is not truncated.
+	 *
+	 * @param filename is the name of the file.
+	 * @param block_size is the size of a block in bytes.
+	 * @param n_blocks is the number of blocks. The file grows up to this
+	 * size.
+	 */
+	file_block_device(const char *filename, size_t block_size,
+	                  uint32_t n_blocks);
+
+	~file_block_device() override;
+
+	file_block_device(const file_block_device &) = delete;
+	file_block_device &operator=(const file_block_device &) = delete;
+
+	/**
+	 * Returns true if the file was opened successfully.
+	 */
+	bool good() const { return m_file != nullptr; }
+
+	size_t block_size() const override { return m_block_size; }
+	uint32_t n_blocks() const override { return m_n_blocks; }
+	bool read(uint32_t block, uint8_t *buf) override;
+	bool write(uint32_t block, const uint8_t *buf) override;
+};
+#endif
+
+/**
+ * Size of the page header in bytes.
+ */
+static constexpr uint8_t CAPTURE_HEADER_SIZE = 9;
+
+/**
+ * Records the input signal as run lengths. Call sample() with the same input
+ * passed to decoder::sample(). Calls without an edge only extend the
+ * timestamp and cost a few instructions. Completed pages are written to
+ * consecutive blocks of the device, starting with block zero. Once the device
+ * is full, the capture stops.
+ */
+class edge_logger {
+private:
+	/**
+	 * Device the capture is written to.
+	 */
+	block_device &m_dev;
+
+	/**
+	 * Page buffer provided by the caller, one block in size.
+	 */
+	uint8_t *m_page;
+
+	/**
+	 * Number of used bytes in m_page.
+	 */
+	size_t m_len;
+
+	/**
+	 * Index of the next block to write.
+	 */
+	uint32_t m_block = 0;
+
+	/**
+	 * Extended timestamp of the last call to sample().
+	 */
+	uint32_t m_t;
+
+	/**
+	 * Extended timestamp of the last edge.
+	 */
+	uint32_t m_run_start;
+
+	/**
+	 * Extended timestamp at the beginning of the current page.
+	 */
+	uint32_t m_page_start;
+
+	/**
+	 * Last 16-bit timestamp passed to sample().
+	 */
+	uint16_t m_last_t;
+
+	/**
+	 * Current input level.
+	 */
+	bool m_value;
+
+	/**
+	 * Input level at the beginning of the current page.
+	 */
+	bool m_page_value;
+
+	/**
+	 * Set once the device is full or a write failed.
+	 */
+	bool m_stopped = false;
+
+	/**
+	 * Number of edges which could not be recorded.
+	 */
+	uint32_t m_dropped = 0;
+
+	/**
+	 * Starts a new page at the current run.
+	 */
+	void start_page();
+
+	/**
+	 * Records an edge at the current time.
+	 */
+	void edge(bool value);
+
+public:
+	/**
+	 * Creates a new logger.
+	 *
+	 * @param dev is the device the capture is written to.
+	 * @param page is a buffer of dev.block_size() bytes.
+	 * @param value is the current input level.
+	 * @param t is the current timestamp in milliseconds. Timestamps in the
+	 * capture are relative to this timestamp.
+	 */
+	edge_logger(block_device &dev, uint8_t *page, bool value, uint16_t t);
+
+	/**
+	 * Processes a new input sample.
+	 *
+	 * @param value is the input bit.
+	 * @param t is a monotonous timestamp in milliseconds. Must be called at
+	 * least every 65 seconds.
+	 */
+	void sample(bool value, uint16_t t)
+	{
+		m_t += uint16_t(t - m_last_t);
+		m_last_t = t;
+		if (value != m_value) {
+			edge(value);
+		}
+	}
+
+	/**
+	 * Writes the current page to the device, even if it is not full. The
+	 * following edges are written to a new page.
+	 *
+	 * @return false if the page could not be written.
+	 */
+	bool flush();
+
+	/**
+	 * Returns the number of edges which could not be recorded because the
+	 * device is full or a write failed.
+	 */
+	uint32_t get_dropped() const { return m_dropped; }
+};
+
+/**
+ * Edge read from a capture.
+ */
+struct capture_edge {
+	/**
+	 * Timestamp of the edge in milliseconds.
+	 */
+	uint32_t t;
+
+	/**
+	 * Input level after the edge.
+	 */
+	bool value;
+};
+
+/**
+ * Reads a capture written by edge_logger.
+ */
+class capture_reader {
+private:
+	/**
+	 * Device the capture is read from.
+	 */
+	block_device &m_dev;
+
+	/**
+	 * Page buffer provided by the caller, one block in size.
+	 */
+	uint8_t *m_page;
+
+	/**
+	 * Index of the next block to read.
+	 */
+	uint32_t m_block = 0;
+
+	/**
+	 * Read position in m_page.
+	 */
+	size_t m_pos = 0;
+
+	/**
+	 * Number of used bytes in m_page.
+	 */
+	size_t m_len = 0;
+
+	/**
+	 * Timestamp of the last edge.
+	 */
+	uint32_t m_t = 0;
+
+	/**
+	 * Input level after the last edge.
+	 */
+	bool m_value = false;
+
+	/**
+	 * Reads and validates the next page.
+	 *
+	 * @return false at the end of the capture.
+	 */
+	bool load_page();
+
+public:
+	/**
+	 * Creates a reader and reads the first page.
+	 *
+	 * @param dev is the device the capture is read from.
+	 * @param page is a buffer of dev.block_size() bytes.
+	 */
+	capture_reader(block_device &dev, uint8_t *page);
+
+	/**
+	 * Reads the next edge.
+	 *
+	 * @return false at the end of the capture.
+	 */
+	bool next(capture_edge &e);
+
+	/**
+	 * Returns the timestamp of the last edge read, or the beginning of the
+	 * capture if no edge has been read yet.
+	 */
+	uint32_t time() const { return m_t; }
+
+	/**
+	 * Returns the input level after the last edge read, or at the beginning
+	 * of the capture if no edge has been read yet.
+	 */
+	bool value() const { return m_value; }
+};
+}
+
+#endif /* DCF77_CAPTURE_HPP */
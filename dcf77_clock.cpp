@@ -0,0 +1,184 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dcf77_clock.hpp"
+
+#ifdef DCF77_HAS_REALTIME
+#include <errno.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+namespace dcf77 {
+
+/******************************************************************************
+ * Helper functions                                                           *
+ ******************************************************************************/
+
+/**
+ * Computes the lower 64 bits of (a * b) >> 32 without a 128-bit type.
+ */
+static uint64_t mul_shr32(uint64_t a, uint64_t b)
+{
+	const uint64_t al = a & 0xFFFFFFFF, ah = a >> 32;
+	const uint64_t bl = b & 0xFFFFFFFF, bh = b >> 32;
+	return ((ah * bh) << 32) + ah * bl + al * bh + ((al * bl) >> 32);
+}
+
+/******************************************************************************
+ * Class "timebase"                                                           *
+ ******************************************************************************/
+
+/**
+ * Weight of a new frequency measurement in the running average.
+ */
+static constexpr double RATE_AVG = 1.0 / 8.0;
+
+int64_t timebase::calibrate(uint64_t cycles, uint64_t ref_ns)
+{
+	// The first call only records the anchor
+	if (m_n_cal == 0) {
+		m_anchor_cycles = m_cal_cycles = cycles;
+		m_anchor_ns = m_cal_ns = ref_ns;
+		m_n_cal = 1;
+		return 0;
+	}
+	const uint64_t dc = cycles - m_cal_cycles;
+	if (dc == 0) {
+		return 0;
+	}
+
+	// Measure the counter frequency over the last calibration interval
+	const double rate = double(ref_ns - m_cal_ns) / double(dc);
+	int64_t err = 0;
+	double corr = 0.0;
+	if (m_n_cal == 1) {
+		m_rate = rate;
+		m_anchor_ns = ref_ns;
+	} else {
+		m_rate += (rate - m_rate) * RATE_AVG;
+
+		// Step large phase errors, slew small ones out over the next interval
+		const uint64_t cur_ns = ns(cycles);
+		err = int64_t(ref_ns - cur_ns);
+		if (err > int64_t(MAX_SLEW_NS) || err < -int64_t(MAX_SLEW_NS)) {
+			m_anchor_ns = ref_ns;
+		} else {
+			m_anchor_ns = cur_ns;
+			corr = double(err) / double(dc);
+		}
+	}
+	m_anchor_cycles = cycles;
+	m_mult = uint64_t((m_rate + corr) * 4294967296.0);
+
+	m_cal_cycles = cycles;
+	m_cal_ns = ref_ns;
+	if (m_n_cal < 0xFF) {
+		m_n_cal++;
+	}
+	return err;
+}
+
+uint64_t timebase::ns(uint64_t cycles) const
+{
+	const int64_t dc = int64_t(cycles - m_anchor_cycles);
+	if (dc >= 0) {
+		return m_anchor_ns + mul_shr32(dc, m_mult);
+	}
+	return m_anchor_ns - mul_shr32(-dc, m_mult);
+}
+
+uint64_t timebase::ticks_to_ns(uint16_t t, uint64_t cycles) const
+{
+	const uint64_t now_ms = ns(cycles) / 1000000;
+	const uint16_t age = uint16_t(now_ms) - t;
+	return (now_ms - age) * 1000000;
+}
+
+/******************************************************************************
+ * Class "poller"                                                             *
+ ******************************************************************************/
+
+#ifdef DCF77_HAS_REALTIME
+static uint64_t monotonic_ns()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+bool enable_realtime(int priority, int cpu)
+{
+	bool ok = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+
+	sched_param param;
+	param.sched_priority = priority;
+	ok = sched_setscheduler(0, SCHED_FIFO, &param) == 0 && ok;
+
+	if (cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		ok = sched_setaffinity(0, sizeof(set), &set) == 0 && ok;
+	}
+	return ok;
+}
+
+poller::poller(uint32_t threshold_ns)
+    : m_start_ns(monotonic_ns()),
+      m_deadline_ns(m_start_ns + PERIOD_NS),
+      m_threshold_ns(threshold_ns)
+{
+}
+
+poll_tick poller::wait()
+{
+	timespec ts;
+	ts.tv_sec = m_deadline_ns / 1000000000ULL;
+	ts.tv_nsec = m_deadline_ns % 1000000000ULL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) ==
+	       EINTR) {
+	}
+	const uint64_t now = monotonic_ns();
+
+	// Measure the latency, timestamp late samples with the actual time
+	poll_tick res;
+	const uint64_t latency = now > m_deadline_ns ? now - m_deadline_ns : 0;
+	res.latency_ns = latency > 0xFFFFFFFF ? 0xFFFFFFFF : latency;
+	res.late = latency > m_threshold_ns;
+	res.t = ((res.late ? now : m_deadline_ns) - m_start_ns) / PERIOD_NS;
+	if (res.latency_ns > m_max_latency_ns) {
+		m_max_latency_ns = res.latency_ns;
+	}
+	if (res.late) {
+		m_n_late++;
+	}
+
+	// Skip the deadlines which already passed
+	m_deadline_ns += PERIOD_NS;
+	res.missed = 0;
+	if (m_deadline_ns <= now) {
+		const uint64_t n = (now - m_deadline_ns) / PERIOD_NS + 1;
+		m_deadline_ns += n * PERIOD_NS;
+		res.missed = n > 0xFFFF ? 0xFFFF : n;
+		m_n_missed += n;
+	}
+	return res;
+}
+#endif
+}
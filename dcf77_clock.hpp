@@ -0,0 +1,337 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dcf77_clock.hpp
+ *
+ * Timestamp sources for hosts polling a receiver. Reading the CPU cycle
+ * counter is much cheaper than querying the operating system clock, so the
+ * timebase class converts cycle counts to the millisecond timestamps expected
+ * by the decoder and continuously calibrates the conversion against a
+ * reference clock such as CLOCK_MONOTONIC_RAW. If DCF77_REALTIME is
+ * defined, the poller class provides a periodic one millisecond tick with
+ * absolute deadlines, which measures its own wake-up latency.
+ *
+ * @author Andreas Stöckel
+ */
+
+#ifndef DCF77_CLOCK_HPP
+#define DCF77_CLOCK_HPP
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define DCF77_HAS_CYCLE_COUNTER
+#elif defined(__aarch64__)
+#define DCF77_HAS_CYCLE_COUNTER
+#endif
+
+#if defined(__linux__)
+#include <time.h>
+#define DCF77_HAS_MONOTONIC_RAW
+#endif
+
+/**
+ * If defined, enables the poller class and enable_realtime(). Both rely on
+ * the Linux scheduler and memory locking interfaces and are thus only
+ * available on hosts, for example in a tool polling a receiver attached to a
+ * GPIO pin. Must be defined consistently for all translation units.
+ */
+#ifdef DCF77_REALTIME
+#ifndef __linux__
+#error "DCF77_REALTIME is only supported on Linux"
+#endif
+#define DCF77_HAS_REALTIME
+#endif
+
+namespace dcf77 {
+
+#ifdef DCF77_HAS_CYCLE_COUNTER
+/**
+ * Reads the cycle counter of the CPU (the TSC on x86, the virtual counter on
+ * ARMv8). The counter must run at a constant rate, which is the case for all
+ * recent x86 CPUs ("constant_tsc" and "nonstop_tsc" flags).
+ */
+inline uint64_t read_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	uint64_t res;
+	asm volatile("mrs %0, cntvct_el0" : "=r"(res));
+	return res;
+#endif
+}
+#endif
+
+#ifdef DCF77_HAS_MONOTONIC_RAW
+/**
+ * Returns the current value of CLOCK_MONOTONIC_RAW in nanoseconds. This clock
+ * is not slewed by NTP, so it is a suitable reference for the calibration of
+ * the cycle counter.
+ */
+inline uint64_t monotonic_raw_ns()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+#ifdef DCF77_HAS_REALTIME
+/**
+ * Prepares the calling thread for polling a receiver: locks all current and
+ * future memory pages (mlockall), switches to the SCHED_FIFO scheduling
+ * policy and optionally pins the thread to a single CPU. Ideally, this CPU is
+ * excluded from general scheduling, for example using the isolcpus kernel
+ * parameter. Requires the CAP_SYS_NICE and CAP_IPC_LOCK capabilities.
+ *
+ * @param priority is the SCHED_FIFO priority between 1 and 99.
+ * @param cpu is the CPU the thread is pinned to, or -1.
+ * @return false if any of the steps failed. The remaining steps are
+ * performed nevertheless.
+ */
+bool enable_realtime(int priority, int cpu = -1);
+
+/**
+ * Timing information about one tick of the poller.
+ */
+struct poll_tick {
+	/**
+	 * Timestamp in milliseconds to pass to decoder::sample() together with
+	 * the input sampled right after poller::wait() returned.
+	 */
+	uint16_t t;
+
+	/**
+	 * True if the thread woke up later than the threshold. The timestamp t
+	 * then refers to the actual wake-up time, truncated to whole
+	 * milliseconds, instead of the deadline.
+	 */
+	bool late;
+
+	/**
+	 * Number of ticks skipped before this one because the thread woke up
+	 * more than one period late.
+	 */
+	uint16_t missed;
+
+	/**
+	 * Time between the deadline and the actual wake-up in nanoseconds.
+	 */
+	uint32_t latency_ns;
+};
+
+/**
+ * Periodic one millisecond tick for polling a receiver input. The thread
+ * sleeps until absolute deadlines using clock_nanosleep(), so wake-up
+ * latencies do not accumulate. Each tick reports the latency relative to its
+ * deadline; samples read on time are timestamped with the deadline, samples
+ * read late with the actual time truncated to whole milliseconds and
+ * flagged. The timestamp error is thus at most the threshold for samples read
+ * on time and less than one millisecond for late samples; truncation keeps
+ * the timestamps strictly increasing.
+ */
+class poller {
+public:
+	/**
+	 * Period of the tick in nanoseconds.
+	 */
+	static constexpr uint32_t PERIOD_NS = 1000000;
+
+private:
+	/**
+	 * CLOCK_MONOTONIC time of timestamp zero in nanoseconds.
+	 */
+	uint64_t m_start_ns;
+
+	/**
+	 * Deadline of the next tick.
+	 */
+	uint64_t m_deadline_ns;
+
+	/**
+	 * Latency above which a tick is flagged as late.
+	 */
+	uint32_t m_threshold_ns;
+
+	/**
+	 * Largest latency observed so far.
+	 */
+	uint32_t m_max_latency_ns = 0;
+
+	/**
+	 * Number of ticks flagged as late.
+	 */
+	uint32_t m_n_late = 0;
+
+	/**
+	 * Number of skipped ticks.
+	 */
+	uint32_t m_n_missed = 0;
+
+public:
+	/**
+	 * Creates a poller. The first tick is due one period after construction.
+	 *
+	 * @param threshold_ns is the latency above which ticks are flagged as
+	 * late.
+	 */
+	poller(uint32_t threshold_ns = PERIOD_NS / 4);
+
+	/**
+	 * Sleeps until the next deadline.
+	 */
+	poll_tick wait();
+
+	/**
+	 * Returns the largest wake-up latency observed so far in nanoseconds.
+	 */
+	uint32_t get_max_latency_ns() const { return m_max_latency_ns; }
+
+	/**
+	 * Returns the number of ticks flagged as late.
+	 */
+	uint32_t get_late() const { return m_n_late; }
+
+	/**
+	 * Returns the number of skipped ticks.
+	 */
+	uint32_t get_missed() const { return m_n_missed; }
+};
+#endif
+
+/**
+ * Converts the readings of a free-running counter into nanoseconds and
+ * milliseconds of a reference clock. The conversion is a multiplication with a
+ * 32.32 fixed-point factor and requires no system call or division by a
+ * variable. The factor and offset are updated by calling calibrate() with
+ * pairs of counter readings and reference timestamps, for example once per
+ * second. Frequency errors are averaged over several calibration intervals,
+ * phase errors are removed by slewing the frequency, so the converted time
+ * remains monotonic unless the error exceeds MAX_SLEW_NS.
+ */
+class timebase {
+public:
+	/**
+	 * Phase errors larger than this value (in nanoseconds) are corrected
+	 * immediately instead of being slewed out.
+	 */
+	static constexpr uint32_t MAX_SLEW_NS = 1000000;
+
+private:
+	/**
+	 * Counter reading at which the conversion is anchored.
+	 */
+	uint64_t m_anchor_cycles = 0;
+
+	/**
+	 * Reference time corresponding to m_anchor_cycles in nanoseconds.
+	 */
+	uint64_t m_anchor_ns = 0;
+
+	/**
+	 * Nanoseconds per counter increment as 32.32 fixed-point number,
+	 * including the phase correction.
+	 */
+	uint64_t m_mult = 0;
+
+	/**
+	 * Estimated nanoseconds per counter increment.
+	 */
+	double m_rate = 0.0;
+
+	/**
+	 * Counter reading at the last calibration.
+	 */
+	uint64_t m_cal_cycles = 0;
+
+	/**
+	 * Reference time at the last calibration.
+	 */
+	uint64_t m_cal_ns = 0;
+
+	/**
+	 * Number of calibrations performed so far, saturates at 255.
+	 */
+	uint8_t m_n_cal = 0;
+
+public:
+	/**
+	 * Updates the conversion with a new pair of readings.
+	 *
+	 * @param cycles is the counter reading.
+	 * @param ref_ns is the reference time in nanoseconds at which the counter
+	 * was read.
+	 * @return the difference between the reference time and the converted
+	 * counter reading in nanoseconds before the update. Zero for the first
+	 * two calls.
+	 */
+	int64_t calibrate(uint64_t cycles, uint64_t ref_ns);
+
+#if defined(DCF77_HAS_CYCLE_COUNTER) && defined(DCF77_HAS_MONOTONIC_RAW)
+	/**
+	 * Calibrates against CLOCK_MONOTONIC_RAW. The counter is read before and
+	 * after the clock, the mean of both readings is used.
+	 */
+	int64_t calibrate_now()
+	{
+		const uint64_t c0 = read_cycles();
+		const uint64_t ref_ns = monotonic_raw_ns();
+		const uint64_t c1 = read_cycles();
+		return calibrate(c0 + (c1 - c0) / 2, ref_ns);
+	}
+#endif
+
+	/**
+	 * Returns true once at least two calibrations have been performed.
+	 */
+	bool calibrated() const { return m_n_cal >= 2; }
+
+	/**
+	 * Converts a counter reading into reference time in nanoseconds.
+	 */
+	uint64_t ns(uint64_t cycles) const;
+
+	/**
+	 * Converts a counter reading into a millisecond timestamp as expected by
+	 * decoder::sample().
+	 */
+	uint16_t ticks(uint64_t cycles) const { return ns(cycles) / 1000000; }
+
+	/**
+	 * Converts a millisecond timestamp returned by the decoder, such as the
+	 * result of decoder::get_phase(), back into reference time. The timestamp
+	 * must lie at most 65 seconds before the given counter reading.
+	 *
+	 * @param t is the timestamp in milliseconds.
+	 * @param cycles is a current counter reading.
+	 * @return the reference time of the beginning of the millisecond t in
+	 * nanoseconds.
+	 */
+	uint64_t ticks_to_ns(uint16_t t, uint64_t cycles) const;
+
+	/**
+	 * Returns the estimated counter frequency in Hz.
+	 */
+	double frequency() const { return m_rate > 0.0 ? 1e9 / m_rate : 0.0; }
+};
+}
+
+#endif /* DCF77_CLOCK_HPP */
@@ -0,0 +1,96 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dcf77_format.hpp"
+
+namespace dcf77 {
+
+/******************************************************************************
+ * Class "timestamp_formatter"                                                *
+ ******************************************************************************/
+
+const char timestamp_formatter::DIGITS[200] = {
+    '0', '0', '0', '1', '0', '2', '0', '3', '0', '4', '0', '5', '0', '6', '0',
+    '7', '0', '8', '0', '9', '1', '0', '1', '1', '1', '2', '1', '3', '1', '4',
+    '1', '5', '1', '6', '1', '7', '1', '8', '1', '9', '2', '0', '2', '1', '2',
+    '2', '2', '3', '2', '4', '2', '5', '2', '6', '2', '7', '2', '8', '2', '9',
+    '3', '0', '3', '1', '3', '2', '3', '3', '3', '4', '3', '5', '3', '6', '3',
+    '7', '3', '8', '3', '9', '4', '0', '4', '1', '4', '2', '4', '3', '4', '4',
+    '4', '5', '4', '6', '4', '7', '4', '8', '4', '9', '5', '0', '5', '1', '5',
+    '2', '5', '3', '5', '4', '5', '5', '5', '6', '5', '7', '5', '8', '5', '9',
+    '6', '0', '6', '1', '6', '2', '6', '3', '6', '4', '6', '5', '6', '6', '6',
+    '7', '6', '8', '6', '9', '7', '0', '7', '1', '7', '2', '7', '3', '7', '4',
+    '7', '5', '7', '6', '7', '7', '7', '8', '7', '9', '8', '0', '8', '1', '8',
+    '2', '8', '3', '8', '4', '8', '5', '8', '6', '8', '7', '8', '8', '8', '9',
+    '9', '0', '9', '1', '9', '2', '9', '3', '9', '4', '9', '5', '9', '6', '9',
+    '7', '9', '8', '9', '9'};
+
+/**
+ * Writes a two-digit number, modulo 100 in case of an invalid field.
+ */
+static void put_digits(char *out, uint8_t v)
+{
+	memcpy(out, timestamp_formatter::DIGITS + 2 * (v % 100), 2);
+}
+
+void timestamp_formatter::render_minute(const data &frame, bool next)
+{
+	uint8_t year = frame.year() - 2000, month = frame.month();
+	uint8_t day = frame.day(), hour = frame.hour(), minute = frame.minute();
+	bool cest = frame.raw.cest;
+	if (next && ++minute == 60) {
+		// The hour following an announced change of the UTC offset starts
+		// one hour later (CET to CEST) or earlier (CEST to CET)
+		minute = 0;
+		if (frame.raw.dst_leap_hour) {
+			hour += cest ? -1 : 1;
+			cest = !cest;
+		}
+		if (++hour == 24) {
+			static constexpr uint8_t DAYS[12] = {31, 28, 31, 30, 31, 30,
+			                                     31, 31, 30, 31, 30, 31};
+			const uint8_t n_days =
+			    DAYS[(month - 1) % 12] + (month == 2 && year % 4 == 0 ? 1 : 0);
+			hour = 0;
+			if (++day > n_days) {
+				day = 1;
+				if (++month > 12) {
+					month = 1;
+					year = (year + 1) % 100;
+				}
+			}
+		}
+	}
+
+	memcpy(m_buf, "20YY-MM-DDThh:mm:ss.sss+0h:00", LENGTH);
+	put_digits(m_buf + 2, year);
+	put_digits(m_buf + 5, month);
+	put_digits(m_buf + 8, day);
+	put_digits(m_buf + 11, hour);
+	put_digits(m_buf + 14, minute);
+	m_buf[25] = cest ? '2' : '1';
+	m_key = (frame.bitstream & KEY_MASK) | (next ? 1 : 0);
+}
+
+void timestamp_formatter::render_second(uint16_t ms)
+{
+	const uint8_t second = ms / 1000;
+	memcpy(m_buf + SECOND_POS, DIGITS + 2 * second, 2);
+	m_second_begin = second * 1000;
+}
+}
@@ -0,0 +1,141 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dcf77_format.hpp
+ *
+ * Text timestamps for loggers stamping many lines with the received time.
+ * The formatter renders the date, hour and minute once per minute and the
+ * seconds once per second, so formatting a timestamp mostly consists of
+ * writing the milliseconds and copying a fixed-size buffer.
+ *
+ * @author Andreas Stöckel
+ */
+
+#ifndef DCF77_FORMAT_HPP
+#define DCF77_FORMAT_HPP
+
+#include <string.h>
+
+#include "dcf77.hpp"
+
+namespace dcf77 {
+
+/**
+ * Formats the time described by a frame plus an offset in milliseconds as
+ * ISO 8601 local time with UTC offset, for example
+ * "2016-10-30T02:59:59.999+02:00". Offsets beyond the end of the minute, for
+ * example after a frame was missed, carry into the following minute,
+ * including announced changes between CET and CEST. The output is not
+ * null-terminated.
+ */
+class timestamp_formatter {
+public:
+	/**
+	 * Length of a formatted timestamp in characters.
+	 */
+	static constexpr size_t LENGTH = 29;
+
+	/**
+	 * Two-digit decimal representations of the numbers 0 to 99.
+	 */
+	static const char DIGITS[200];
+
+private:
+	/**
+	 * Offsets of the fields in the formatted timestamp.
+	 */
+	static constexpr uint8_t SECOND_POS = 17;
+	static constexpr uint8_t MILLI_POS = 20;
+
+	/**
+	 * Mask of the frame bits which determine the rendered minute, from the
+	 * CEST flag up to the year.
+	 */
+	static constexpr uint64_t KEY_MASK = 0x03FFFFFFFFFE0000ULL;
+
+	/**
+	 * Rendered timestamp. The minute and seconds fields are valid for m_key
+	 * and m_second_begin.
+	 */
+	char m_buf[LENGTH];
+
+	/**
+	 * Masked bitstream of the frame rendered into m_buf, with bit zero set if
+	 * the following minute was rendered. All ones if none.
+	 */
+	uint64_t m_key = ~0ULL;
+
+	/**
+	 * Offset in milliseconds at which the second rendered into m_buf begins.
+	 */
+	uint16_t m_second_begin = 0;
+
+	/**
+	 * Renders the date, hour, minute and UTC offset of the given frame or of
+	 * the minute following it.
+	 */
+	void render_minute(const data &frame, bool next);
+
+	/**
+	 * Renders the second containing the given offset.
+	 */
+	void render_second(uint16_t ms);
+
+public:
+	/**
+	 * Formats a timestamp.
+	 *
+	 * @param frame is the frame describing the minute, for example the result
+	 * of decoder::get_data().
+	 * @param ms is the time since the beginning of the minute in milliseconds,
+	 * for example the current timestamp minus decoder::get_phase(). Values
+	 * from 60000 to 60999 denote a leap second if the frame announces one and
+	 * describes the last minute of the hour. Values beyond the end of the
+	 * minute belong to the following minute.
+	 * @param out receives LENGTH characters.
+	 * @return LENGTH.
+	 */
+	size_t format(const data &frame, uint16_t ms, char *out)
+	{
+		uint64_t key = frame.bitstream & KEY_MASK;
+		if (ms >= 60000) {
+			const bool leap = frame.raw.leap_second && frame.raw.minute == 0x59;
+			const uint16_t length = leap ? 61000 : 60000;
+			if (ms >= length) {
+				key |= 1;
+				ms -= length;
+			}
+		}
+		if (key != m_key) {
+			render_minute(frame, key & 1);
+			render_second(ms);
+		} else if (uint16_t(ms - m_second_begin) >= 1000) {
+			render_second(ms);
+		}
+		const uint16_t milli = ms - m_second_begin;
+		const uint8_t hundreds = milli / 100;
+		m_buf[MILLI_POS] = '0' + hundreds;
+		memcpy(m_buf + MILLI_POS + 1, DIGITS + 2 * (milli - 100 * hundreds), 2);
+		memcpy(out, m_buf, LENGTH);
+		return LENGTH;
+	}
+};
+}
+
+#endif /* DCF77_FORMAT_HPP */
@@ -0,0 +1,256 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+
+#include "dcf77_frontend.hpp"
+
+namespace dcf77 {
+
+/******************************************************************************
+ * Class "noise_blanker"                                                      *
+ ******************************************************************************/
+
+noise_blanker::noise_blanker(uint8_t factor, uint16_t hold)
+    : m_factor(factor), m_hold(hold)
+{
+}
+
+uint32_t noise_blanker::blank(int16_t *pcm, size_t n, int32_t threshold,
+                              size_t &n_kept)
+{
+	// Blanked samples are left out of the average, so impulses do not raise
+	// the threshold
+	uint32_t sum = 0;
+	n_kept = 0;
+	for (size_t k = 0; k < n; k++) {
+		const int32_t v = pcm[k] < 0 ? -int32_t(pcm[k]) : int32_t(pcm[k]);
+		if (v > threshold) {
+			m_remaining = m_hold;
+		}
+		if (m_remaining > 0 && m_run >= MAX_RUN) {
+			// Sustained rise of the level, learn the average anew
+			m_remaining = 0;
+			m_n = 0;
+			threshold = 0x8000;
+		}
+		if (m_remaining > 0) {
+			pcm[k] = 0;
+			m_remaining--;
+			m_run++;
+			m_blanked++;
+		} else {
+			m_run = 0;
+			sum += v;
+			n_kept++;
+		}
+	}
+	return sum;
+}
+
+void noise_blanker::process(int16_t *pcm, size_t n)
+{
+	while (n > 0) {
+		const size_t chunk = n < BLOCK ? n : BLOCK;
+		const uint32_t t = (uint64_t(m_level) * m_factor) >> 16;
+		const int32_t threshold = t < 0x8000 ? int32_t(t) : 0x8000;
+
+		// Most blocks contain no impulse. Check this first with a loop free of
+		// branches.
+		uint32_t sum = 0;
+		int32_t max = 0;
+		for (size_t k = 0; k < chunk; k++) {
+			const int32_t v = pcm[k] < 0 ? -int32_t(pcm[k]) : int32_t(pcm[k]);
+			sum += v;
+			max = v > max ? v : max;
+		}
+		size_t n_kept = chunk;
+		if (m_remaining > 0 || (max > threshold && m_n >= WARMUP)) {
+			sum = blank(pcm, chunk, threshold, n_kept);
+		} else {
+			m_run = 0;
+		}
+
+		// Update the average amplitude, using the plain mean until LEVEL_BLOCKS
+		// blocks have been processed. Blocks which were blanked entirely do
+		// not contribute.
+		if (n_kept > 0) {
+			if (m_n < LEVEL_BLOCKS) {
+				m_n++;
+			}
+			const int64_t mean = (int64_t(sum) << 16) / int64_t(n_kept);
+			m_level += (mean - int64_t(m_level)) / m_n;
+		}
+
+		pcm += chunk;
+		n -= chunk;
+	}
+}
+
+/******************************************************************************
+ * Class "carrier_frontend"                                                   *
+ ******************************************************************************/
+
+static constexpr double PI = 3.14159265358979323846;
+
+/**
+ * Proportional and integral gain of the PLL, update rate is 1 kHz. This
+ * corresponds to a natural frequency of about 0.8 Hz and a damping of one.
+ */
+static constexpr double PLL_KP = 1e-2;
+static constexpr double PLL_KI = 2.5e-5;
+
+/**
+ * Gain of the frequency discriminator used to pull the PLL into lock. The
+ * discriminator is disabled once the PLL is locked, since it adds considerable
+ * noise to the frequency estimate.
+ */
+static constexpr double PLL_KF = 5e-3;
+
+/**
+ * Weight of a new sample in the lock indicator.
+ */
+static constexpr double LOCK_AVG = 1.0 / 1024.0;
+
+/**
+ * Weight of a new frequency measurement in the long-term average.
+ */
+static constexpr double FREQ_AVG = 1.0 / 8192.0;
+
+/**
+ * Decay of the peak amplitude per millisecond.
+ */
+static constexpr float PEAK_DECAY = 1.0f - 1.0f / 16384.0f;
+
+static double wrap(double phi)
+{
+	while (phi > PI) {
+		phi -= 2.0 * PI;
+	}
+	while (phi < -PI) {
+		phi += 2.0 * PI;
+	}
+	return phi;
+}
+
+carrier_frontend::carrier_frontend(uint32_t sample_rate)
+    : m_block(0), m_block_step(0.0)
+{
+	if (sample_rate == 0 || (sample_rate % 1000) != 0 ||
+	    sample_rate / 1000 > MAX_BLOCK) {
+		return;
+	}
+	m_block = sample_rate / 1000;
+
+	// The carrier appears at this frequency after sampling
+	const uint32_t f = CARRIER % sample_rate;
+	for (uint16_t k = 0; k < m_block; k++) {
+		const double phi = 2.0 * PI * double(uint64_t(f) * k % sample_rate) /
+		                   double(sample_rate);
+		m_cos[k] = int16_t(lrint(16384.0 * cos(phi)));
+		m_sin[k] = int16_t(lrint(-16384.0 * sin(phi)));
+	}
+	m_block_step = 2.0 * PI * double(f % 1000) / 1000.0;
+}
+
+frontend_sample carrier_frontend::finish_block()
+{
+	// Rotate the baseband sample by the nominal carrier phase at the
+	// beginning of the block and the phase correction of the PLL
+	const double rot = -(m_block_phase + m_pll_phase);
+	const double c = cos(rot), s = sin(rot);
+	const double i = double(m_acc_i) * c - double(m_acc_q) * s;
+	const double q = double(m_acc_i) * s + double(m_acc_q) * c;
+	m_acc_i = m_acc_q = 0;
+	m_block_phase = fmod(m_block_phase + m_block_step, 2.0 * PI);
+
+	// Track the peak amplitude
+	const float a = float(sqrt(i * i + q * q));
+	m_peak = a > m_peak ? a : m_peak * PEAK_DECAY;
+	const double w = m_peak > 0.0f ? double(a / m_peak) : 0.0;
+
+	// Update the PLL. Errors are weighted with the amplitude, since the phase
+	// is poorly defined while the carrier is lowered. The frequency average
+	// starts as a plain mean and becomes an exponential average.
+	const double phi = atan2(q, i);
+	const double err = phi * w;
+	const double dphi = wrap(phi - m_last_phase) * w;
+	m_last_phase = phi;
+	m_lock += (cos(phi) * w - m_lock) * LOCK_AVG;
+	m_pll_freq += PLL_KI * err + (locked() ? 0.0 : PLL_KF * dphi);
+	m_pll_phase = wrap(m_pll_phase + m_pll_freq + PLL_KP * err);
+	m_freq_avg += (m_pll_freq - m_freq_avg) *
+	              (m_n * FREQ_AVG < 1.0 ? 1.0 / (m_n + 1) : FREQ_AVG);
+	m_n++;
+
+	// Advance the corrected time by one millisecond of the actual sample
+	// clock
+	const double eps = clock_offset_ppb() * 1e-9;
+	m_time += uint64_t(4294967296.0 / (1.0 + eps));
+
+	// Scale the amplitude to the recent peak amplitude
+	frontend_sample res;
+	res.amplitude = uint8_t(255.0 * w);
+	res.t = uint16_t(m_time >> 32);
+	return res;
+}
+
+size_t carrier_frontend::process(const int16_t *pcm, size_t n,
+                                 frontend_sample *out)
+{
+	if (!good()) {
+		return 0;
+	}
+	size_t n_out = 0;
+	while (n > 0) {
+		// Mix the samples of the current millisecond down to baseband and
+		// integrate them. Integer arithmetic lets the compiler vectorise this
+		// loop.
+		const size_t chunk = n < size_t(m_block - m_pos) ? n : m_block - m_pos;
+		const int16_t *c = m_cos + m_pos, *s = m_sin + m_pos;
+		int64_t acc_i = 0, acc_q = 0;
+		for (size_t k = 0; k < chunk; k++) {
+			acc_i += int32_t(pcm[k]) * c[k];
+			acc_q += int32_t(pcm[k]) * s[k];
+		}
+		m_acc_i += acc_i;
+		m_acc_q += acc_q;
+		m_pos += chunk;
+		pcm += chunk;
+		n -= chunk;
+
+		if (m_pos == m_block) {
+			out[n_out++] = finish_block();
+			m_pos = 0;
+		}
+	}
+	return n_out;
+}
+
+double carrier_frontend::carrier_offset() const
+{
+	return m_freq_avg * 1000.0 / (2.0 * PI);
+}
+
+double carrier_frontend::clock_offset_ppb() const
+{
+	// The carrier appears at CARRIER / (1 + eps) if the sample clock is too
+	// fast by a factor of 1 + eps
+	return (double(CARRIER) / (double(CARRIER) + carrier_offset()) - 1.0) * 1e9;
+}
+}
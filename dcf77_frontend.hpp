@@ -0,0 +1,320 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dcf77_frontend.hpp
+ *
+ * Front-end for decoding PCM recordings of the 77.5 kHz signal, for example
+ * from a sound card or an SDR. The front-end mixes the carrier down to
+ * baseband, decimates the result to one sample per millisecond and produces
+ * the carrier amplitude expected by decoder::sample_amplitude(). Since the
+ * carrier frequency is far more precise than the clock of the recording, the
+ * front-end also tracks the carrier phase and uses the measured frequency
+ * offset to correct the timestamps passed to the decoder. An optional noise
+ * blanker removes impulsive interference from the recording beforehand.
+ *
+ * @author Andreas Stöckel
+ */
+
+#ifndef DCF77_FRONTEND_HPP
+#define DCF77_FRONTEND_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace dcf77 {
+
+/**
+ * Output of the carrier_frontend class, one per millisecond of input.
+ */
+struct frontend_sample {
+	/**
+	 * Carrier amplitude, scaled to the largest recently observed amplitude.
+	 */
+	uint8_t amplitude;
+
+	/**
+	 * Timestamp in milliseconds, corrected for the estimated sample clock
+	 * offset.
+	 */
+	uint16_t t;
+};
+
+/**
+ * Removes short, strong impulses, such as those caused by thyristors or
+ * switch-mode power supplies, from a PCM signal before it is passed to the
+ * carrier_frontend. Samples exceeding a multiple of the average absolute
+ * amplitude are set to zero, together with a number of following samples
+ * covering the ringing of the receiver. The average is updated once per block
+ * of BLOCK samples from the samples which were not blanked; blocks without
+ * impulses are processed by a loop the compiler can vectorise. If blanking
+ * continues for more than MAX_RUN samples, the input is not an impulse but a
+ * sustained rise of the signal level, for example the full carrier returning
+ * after the average was learned while it was lowered. Blanking then stops
+ * and the average is learned anew.
+ */
+class noise_blanker {
+public:
+	/**
+	 * Number of samples per update of the average amplitude.
+	 */
+	static constexpr uint8_t BLOCK = 64;
+
+	/**
+	 * Number of blocks processed before samples are blanked.
+	 */
+	static constexpr uint8_t WARMUP = 16;
+
+	/**
+	 * Time constant of the average amplitude in blocks.
+	 */
+	static constexpr uint16_t LEVEL_BLOCKS = 1024;
+
+	/**
+	 * Maximum number of consecutive blanked samples.
+	 */
+	static constexpr uint16_t MAX_RUN = 4 * BLOCK;
+
+private:
+	/**
+	 * Average absolute amplitude as 16.16 fixed-point number.
+	 */
+	uint32_t m_level = 0;
+
+	/**
+	 * Number of blocks included in m_level, saturates at LEVEL_BLOCKS.
+	 */
+	uint16_t m_n = 0;
+
+	/**
+	 * Threshold as multiple of the average absolute amplitude.
+	 */
+	uint8_t m_factor;
+
+	/**
+	 * Number of samples blanked after each impulse.
+	 */
+	uint16_t m_hold;
+
+	/**
+	 * Number of samples still to be blanked.
+	 */
+	uint16_t m_remaining = 0;
+
+	/**
+	 * Number of consecutive samples blanked so far.
+	 */
+	uint16_t m_run = 0;
+
+	/**
+	 * Total number of blanked samples.
+	 */
+	uint32_t m_blanked = 0;
+
+	/**
+	 * Blanks impulses in a block of at most BLOCK samples.
+	 *
+	 * @param n_kept receives the number of samples which were not blanked.
+	 * @return the sum of the absolute amplitudes of these samples.
+	 */
+	uint32_t blank(int16_t *pcm, size_t n, int32_t threshold, size_t &n_kept);
+
+public:
+	/**
+	 * Creates a new noise blanker.
+	 *
+	 * @param factor is the threshold as multiple of the average absolute
+	 * amplitude. For a sine wave the peak amplitude is about 1.6 times the
+	 * average absolute amplitude, for Gaussian noise eight times the average
+	 * corresponds to 6.4 standard deviations.
+	 * @param hold is the number of samples blanked after each sample exceeding
+	 * the threshold.
+	 */
+	noise_blanker(uint8_t factor = 8, uint16_t hold = 16);
+
+	/**
+	 * Blanks impulses in the given signal in place.
+	 *
+	 * @param pcm is the signal.
+	 * @param n is the number of samples.
+	 */
+	void process(int16_t *pcm, size_t n);
+
+	/**
+	 * Returns the average absolute amplitude.
+	 */
+	uint16_t get_level() const { return m_level >> 16; }
+
+	/**
+	 * Returns the total number of blanked samples.
+	 */
+	uint32_t get_blanked() const { return m_blanked; }
+};
+
+/**
+ * Mixes a real-valued PCM signal down to baseband using a fixed-point
+ * complex mixer, integrates it over one millisecond and tracks the carrier
+ * phase with a frequency-assisted phase-locked loop. The sample rate must be a
+ * multiple of 1000 Hz. Sample rates below twice the carrier frequency are
+ * supported as long as the aliased carrier is not close to zero or half the
+ * sample rate.
+ */
+class carrier_frontend {
+public:
+	/**
+	 * Maximum number of samples per millisecond, i.e. a maximum sample rate
+	 * of 1.024 MHz.
+	 */
+	static constexpr uint16_t MAX_BLOCK = 1024;
+
+	/**
+	 * Nominal DCF77 carrier frequency in Hz.
+	 */
+	static constexpr uint32_t CARRIER = 77500;
+
+	/**
+	 * Value of the lock indicator above which the PLL is considered locked.
+	 */
+	static constexpr double LOCK_THRESHOLD = 0.5;
+
+private:
+	/**
+	 * Mixer coefficients for one millisecond, cosine and negative sine of the
+	 * aliased carrier phase, 1.14 fixed-point.
+	 */
+	int16_t m_cos[MAX_BLOCK], m_sin[MAX_BLOCK];
+
+	/**
+	 * Number of samples per millisecond.
+	 */
+	uint16_t m_block;
+
+	/**
+	 * Number of samples of the current millisecond processed so far.
+	 */
+	uint16_t m_pos = 0;
+
+	/**
+	 * Accumulated in-phase and quadrature components of the current
+	 * millisecond.
+	 */
+	int64_t m_acc_i = 0, m_acc_q = 0;
+
+	/**
+	 * Phase advance of the nominal carrier per millisecond in radians.
+	 */
+	double m_block_step;
+
+	/**
+	 * Nominal carrier phase at the beginning of the current millisecond.
+	 */
+	double m_block_phase = 0.0;
+
+	/**
+	 * Phase correction of the PLL in radians.
+	 */
+	double m_pll_phase = 0.0;
+
+	/**
+	 * Frequency correction of the PLL in radians per millisecond.
+	 */
+	double m_pll_freq = 0.0;
+
+	/**
+	 * Phase of the last baseband sample, used for frequency acquisition.
+	 */
+	double m_last_phase = 0.0;
+
+	/**
+	 * Lock indicator, average of the cosine of the phase error weighted with
+	 * the amplitude.
+	 */
+	double m_lock = 0.0;
+
+	/**
+	 * Long-term average of m_pll_freq.
+	 */
+	double m_freq_avg = 0.0;
+
+	/**
+	 * Largest recently observed amplitude.
+	 */
+	float m_peak = 0.0f;
+
+	/**
+	 * Corrected time in milliseconds as 32.32 fixed-point number.
+	 */
+	uint64_t m_time = 0;
+
+	/**
+	 * Number of milliseconds processed.
+	 */
+	uint32_t m_n = 0;
+
+	/**
+	 * Updates the PLL with the baseband sample of one millisecond.
+	 *
+	 * @return the output sample.
+	 */
+	frontend_sample finish_block();
+
+public:
+	/**
+	 * Creates a new front-end.
+	 *
+	 * @param sample_rate is the nominal sample rate of the recording in Hz.
+	 * Must be a multiple of 1000 and at most 1000 * MAX_BLOCK.
+	 */
+	carrier_frontend(uint32_t sample_rate);
+
+	/**
+	 * Returns false if the sample rate is not supported.
+	 */
+	bool good() const { return m_block > 0; }
+
+	/**
+	 * Processes a block of PCM samples.
+	 *
+	 * @param pcm is the input signal.
+	 * @param n is the number of input samples.
+	 * @param out receives one output sample per completed millisecond. Must
+	 * have space for n / (sample_rate / 1000) + 1 samples.
+	 * @return the number of samples written to out.
+	 */
+	size_t process(const int16_t *pcm, size_t n, frontend_sample *out);
+
+	/**
+	 * Returns true if the PLL is locked to the carrier.
+	 */
+	bool locked() const { return m_lock > LOCK_THRESHOLD; }
+
+	/**
+	 * Returns the measured carrier frequency offset in Hz.
+	 */
+	double carrier_offset() const;
+
+	/**
+	 * Returns the estimated sample clock offset in parts per billion. A
+	 * positive value means that the actual sample rate is higher than the
+	 * nominal one.
+	 */
+	double clock_offset_ppb() const;
+};
+}
+
+#endif /* DCF77_FRONTEND_HPP */
@@ -0,0 +1,80 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dcf77_registry.hpp"
+
+namespace dcf77 {
+
+/******************************************************************************
+ * Class "channel_registry"                                                   *
+ ******************************************************************************/
+
+channel_registry::channel_registry(channel *channels, channel_slot *slots,
+                                   uint16_t capacity)
+    : m_channels(channels),
+      m_slots(slots),
+      m_capacity(capacity < NO_SLOT ? capacity : NO_SLOT - 1),
+      m_free(m_capacity > 0 ? 0 : NO_SLOT)
+{
+	// Generation zero is skipped, so no handle equals INVALID_CHANNEL
+	for (uint16_t i = 0; i < m_capacity; i++) {
+		m_slots[i].index = i + 1 < m_capacity ? i + 1 : NO_SLOT;
+		m_slots[i].generation = 1;
+	}
+}
+
+channel_handle channel_registry::add(uint16_t max_gap)
+{
+	if (m_free == NO_SLOT) {
+		return INVALID_CHANNEL;
+	}
+	const uint16_t slot = m_free;
+	m_free = m_slots[slot].index;
+	m_slots[slot].index = m_size;
+
+	channel &c = m_channels[m_size++];
+	c = channel();
+	c.dec = decoder(max_gap);
+	c.slot = slot;
+	return (channel_handle(m_slots[slot].generation) << 16) | slot;
+}
+
+bool channel_registry::remove(channel_handle h)
+{
+	channel *c = get(h);
+	if (!c) {
+		return false;
+	}
+
+	// Keep the channel array dense by moving the last channel into the gap
+	const uint16_t slot = h & 0xFFFF;
+	const uint16_t index = m_slots[slot].index;
+	if (index != m_size - 1) {
+		*c = m_channels[m_size - 1];
+		m_slots[c->slot].index = index;
+	}
+	m_size--;
+
+	// Invalidate existing handles and return the slot to the free list
+	m_slots[slot].generation =
+	    m_slots[slot].generation == 0xFFFF ? 1 : m_slots[slot].generation + 1;
+	m_slots[slot].index = m_free;
+	m_free = slot;
+	return true;
+}
+}
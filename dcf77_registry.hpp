@@ -0,0 +1,244 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dcf77_registry.hpp
+ *
+ * Registry for hosts which add and remove receivers at runtime. The state of
+ * all channels is kept in a single array provided by the caller, packed so
+ * that the active channels occupy its beginning. Channels are referred to by
+ * handles which remain valid while other channels are added or removed.
+ *
+ * @author Andreas Stöckel
+ */
+
+#ifndef DCF77_REGISTRY_HPP
+#define DCF77_REGISTRY_HPP
+
+#include "dcf77.hpp"
+
+namespace dcf77 {
+
+/**
+ * Handle of a channel. Consists of the slot index in the lower and a
+ * generation counter in the upper 16 bits, so handles of removed channels do
+ * not refer to channels added later.
+ */
+using channel_handle = uint32_t;
+
+/**
+ * Handle never returned for a valid channel.
+ */
+static constexpr channel_handle INVALID_CHANNEL = 0;
+
+/**
+ * State of a single receiver channel.
+ */
+struct channel {
+	/**
+	 * Decoder of the channel, including its bit history.
+	 */
+	decoder dec;
+
+	/**
+	 * Number of frames with at least a valid time.
+	 */
+	uint32_t n_valid = 0;
+
+	/**
+	 * Number of frames which could not be validated.
+	 */
+	uint32_t n_invalid = 0;
+
+	/**
+	 * Number of discontinuities of the timestamp.
+	 */
+	uint32_t n_discontinuities = 0;
+
+	/**
+	 * Slot of this channel, see channel_registry.
+	 */
+	uint16_t slot = 0;
+
+	/**
+	 * Passes a sample to the decoder and counts the result.
+	 */
+	decoder::state sample(bool value, uint16_t t)
+	{
+		const decoder::state res = dec.sample(value, t);
+		if (res != decoder::state::no_result) {
+			count(res);
+		}
+		return res;
+	}
+
+	/**
+	 * Passes an analog sample to the decoder and counts the result.
+	 */
+	decoder::state sample_amplitude(uint8_t amplitude, uint16_t t)
+	{
+		const decoder::state res = dec.sample_amplitude(amplitude, t);
+		if (res != decoder::state::no_result) {
+			count(res);
+		}
+		return res;
+	}
+
+	/**
+	 * Updates the counters with a result other than no_result.
+	 */
+	void count(decoder::state res)
+	{
+		if (res >= decoder::state::has_time) {
+			n_valid++;
+		} else if (res == decoder::state::invalid_result) {
+			n_invalid++;
+		} else {
+			n_discontinuities++;
+		}
+	}
+};
+
+/**
+ * Entry of the slot table of a channel_registry.
+ */
+struct channel_slot {
+	/**
+	 * Index of the channel in the channel array if the slot is in use, index
+	 * of the next free slot otherwise.
+	 */
+	uint16_t index;
+
+	/**
+	 * Generation of the slot, incremented whenever its channel is removed.
+	 */
+	uint16_t generation;
+};
+
+/**
+ * Manages a set of channels in arrays provided by the caller. The active
+ * channels always occupy the first size() entries of the channel array, so
+ * processing all of them is a linear pass over contiguous memory. Adding and
+ * removing a channel takes constant time and never allocates memory: free
+ * slots are kept in a list, and removing a channel moves the last channel
+ * into its place. Pointers to channels are therefore only valid until the
+ * next call to remove(); use handles to refer to channels for longer.
+ */
+class channel_registry {
+public:
+	/**
+	 * Marks the end of the free list.
+	 */
+	static constexpr uint16_t NO_SLOT = 0xFFFF;
+
+private:
+	/**
+	 * Channel array provided by the caller.
+	 */
+	channel *m_channels;
+
+	/**
+	 * Slot table provided by the caller.
+	 */
+	channel_slot *m_slots;
+
+	/**
+	 * Number of entries of both arrays.
+	 */
+	uint16_t m_capacity;
+
+	/**
+	 * Number of active channels.
+	 */
+	uint16_t m_size = 0;
+
+	/**
+	 * First free slot.
+	 */
+	uint16_t m_free;
+
+public:
+	/**
+	 * Creates an empty registry.
+	 *
+	 * @param channels is an array of capacity channels.
+	 * @param slots is an array of capacity slots.
+	 * @param capacity is the maximum number of channels, at most NO_SLOT.
+	 */
+	channel_registry(channel *channels, channel_slot *slots,
+	                 uint16_t capacity);
+
+	/**
+	 * Adds a channel with a newly initialised decoder.
+	 *
+	 * @param max_gap is passed to the constructor of the decoder.
+	 * @return the handle of the channel or INVALID_CHANNEL if the registry is
+	 * full.
+	 */
+	channel_handle add(uint16_t max_gap = debounce::MAX_GAP);
+
+	/**
+	 * Removes a channel.
+	 *
+	 * @return false if the handle does not refer to an active channel.
+	 */
+	bool remove(channel_handle h);
+
+	/**
+	 * Returns the channel referred to by the given handle, or nullptr if the
+	 * channel has been removed.
+	 */
+	channel *get(channel_handle h)
+	{
+		const uint16_t slot = h & 0xFFFF;
+		if (slot >= m_capacity || m_slots[slot].generation != (h >> 16) ||
+		    m_slots[slot].index >= m_size ||
+		    m_channels[m_slots[slot].index].slot != slot) {
+			return nullptr;
+		}
+		return &m_channels[m_slots[slot].index];
+	}
+
+	/**
+	 * Returns the handle of the channel at the given position of the channel
+	 * array.
+	 */
+	channel_handle handle(uint16_t i) const
+	{
+		const uint16_t slot = m_channels[i].slot;
+		return (channel_handle(m_slots[slot].generation) << 16) | slot;
+	}
+
+	/**
+	 * Returns the active channels, see size().
+	 */
+	channel *channels() { return m_channels; }
+
+	/**
+	 * Returns the number of active channels.
+	 */
+	uint16_t size() const { return m_size; }
+
+	/**
+	 * Returns the maximum number of channels.
+	 */
+	uint16_t capacity() const { return m_capacity; }
+};
+}
+
+#endif /* DCF77_REGISTRY_HPP */
@@ -0,0 +1,160 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dcf77_store.hpp"
+
+namespace dcf77 {
+
+/******************************************************************************
+ * Helper functions                                                           *
+ ******************************************************************************/
+
+static uint32_t zigzag_encode(uint32_t x)
+{
+	return (x << 1) ^ (0U - (x >> 31));
+}
+
+static uint32_t zigzag_decode(uint32_t x) { return (x >> 1) ^ (0U - (x & 1)); }
+
+/******************************************************************************
+ * Struct "store_block"                                                       *
+ ******************************************************************************/
+
+size_t store_block::decode(uint32_t *out) const
+{
+	if (count == 0) {
+		return 0;
+	}
+	out[0] = first;
+	if (count == 1) {
+		return 1;
+	}
+	out[1] = first + uint32_t(first_delta);
+
+	// Unpack the delta-of-delta values. Each value is extracted independently
+	// of the others and without branches. A value spans at most five bytes.
+	const uint8_t n = count - 2;
+	const uint32_t mask = width >= 32 ? 0xFFFFFFFFU : (1U << width) - 1U;
+	uint32_t *dod = out + 2;
+	for (uint8_t i = 0; i < n; i++) {
+		const uint16_t bit = uint16_t(i) * width;
+		const uint8_t *p = packed + (bit >> 3);
+		const uint64_t w = uint64_t(p[0]) | (uint64_t(p[1]) << 8) |
+		                   (uint64_t(p[2]) << 16) | (uint64_t(p[3]) << 24) |
+		                   (uint64_t(p[4]) << 32);
+		dod[i] = zigzag_decode(uint32_t(w >> (bit & 7)) & mask);
+	}
+
+	// Integrate twice to restore the timestamps
+	uint32_t delta = uint32_t(first_delta);
+	uint32_t t = out[1];
+	for (uint8_t i = 0; i < n; i++) {
+		delta += dod[i];
+		t += delta;
+		dod[i] = t;
+	}
+	return count;
+}
+
+/******************************************************************************
+ * Class "store_writer"                                                       *
+ ******************************************************************************/
+
+store_writer::store_writer()
+{
+	m_block.count = 0;
+	m_result.count = 0;
+}
+
+bool store_writer::push(uint32_t t)
+{
+	const uint8_t i = m_block.count;
+	if (i == 0) {
+		m_block.first = t;
+		m_block.first_delta = 0;
+		m_block.min_delta = 0;
+		m_block.max_delta = 0;
+	} else {
+		const uint32_t delta = t - m_last_t;
+		if (i == 1) {
+			m_block.first_delta = int32_t(delta);
+			m_block.min_delta = int32_t(delta);
+			m_block.max_delta = int32_t(delta);
+		} else {
+			m_values[i - 2] = zigzag_encode(delta - m_last_delta);
+			if (int32_t(delta) < m_block.min_delta) {
+				m_block.min_delta = int32_t(delta);
+			}
+			if (int32_t(delta) > m_block.max_delta) {
+				m_block.max_delta = int32_t(delta);
+			}
+		}
+		m_last_delta = delta;
+	}
+	m_block.last = t;
+	m_block.count++;
+	m_last_t = t;
+
+	if (m_block.count < store_block::BLOCK_SIZE) {
+		return false;
+	}
+	finish();
+	return true;
+}
+
+bool store_writer::flush()
+{
+	if (m_block.count == 0) {
+		return false;
+	}
+	finish();
+	return true;
+}
+
+void store_writer::finish()
+{
+	const uint8_t n = m_block.count > 2 ? m_block.count - 2 : 0;
+
+	// Determine the number of bits required for the largest value
+	uint32_t all = 0;
+	for (uint8_t i = 0; i < n; i++) {
+		all |= m_values[i];
+	}
+	uint8_t width = 0;
+	while (width < 32 && (all >> width)) {
+		width++;
+	}
+
+	// Copy the header and pack the values
+	m_result = m_block;
+	m_result.width = width;
+	for (uint8_t &b : m_result.packed) {
+		b = 0;
+	}
+	uint16_t bit = 0;
+	for (uint8_t i = 0; i < n; i++, bit += width) {
+		const uint64_t w = uint64_t(m_values[i]) << (bit & 7);
+		uint8_t *p = m_result.packed + (bit >> 3);
+		for (uint8_t j = 0; j < 5; j++) {
+			p[j] |= uint8_t(w >> (8 * j));
+		}
+	}
+
+	m_block.count = 0;
+}
+}
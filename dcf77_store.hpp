@@ -0,0 +1,191 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dcf77_store.hpp
+ *
+ * Compressed storage for series of nearly periodic timestamps, such as the
+ * edges marking the beginning of each second. The timestamps are stored in
+ * blocks of up to BLOCK_SIZE values. Within a block, the difference between
+ * consecutive deltas (delta-of-delta) is zigzag encoded and packed with the
+ * smallest bit width that fits all values of the block. For a receiver with a
+ * jitter of a few milliseconds this requires two to four bits per second.
+ *
+ * @author Andreas Stöckel
+ */
+
+#ifndef DCF77_STORE_HPP
+#define DCF77_STORE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace dcf77 {
+
+#pragma pack(push, 1)
+/**
+ * A block of compressed timestamps. The header carries the first and last
+ * timestamp and the range of the deltas within the block, so range queries
+ * and statistics such as the maximum period deviation can skip blocks without
+ * decoding them. Only the first size() bytes of the structure need to be
+ * stored. All timestamps use wrap-around arithmetic, the series is restored
+ * exactly modulo 2^32.
+ */
+struct store_block {
+	/**
+	 * Maximum number of timestamps in a block.
+	 */
+	static constexpr uint8_t BLOCK_SIZE = 64;
+
+	/**
+	 * Size of the header in bytes.
+	 */
+	static constexpr size_t HEADER_SIZE = 22;
+
+	/**
+	 * First timestamp in the block.
+	 */
+	uint32_t first;
+
+	/**
+	 * Last timestamp in the block.
+	 */
+	uint32_t last;
+
+	/**
+	 * Difference between the second and the first timestamp.
+	 */
+	int32_t first_delta;
+
+	/**
+	 * Smallest difference between two consecutive timestamps.
+	 */
+	int32_t min_delta;
+
+	/**
+	 * Largest difference between two consecutive timestamps.
+	 */
+	int32_t max_delta;
+
+	/**
+	 * Number of timestamps in the block.
+	 */
+	uint8_t count;
+
+	/**
+	 * Number of bits per packed delta-of-delta value (0 to 32).
+	 */
+	uint8_t width;
+
+	/**
+	 * Zigzag encoded differences between consecutive deltas, packed least
+	 * significant bit first. Padded so the reader may load past the last
+	 * value.
+	 */
+	uint8_t packed[(BLOCK_SIZE - 2) * 4 + 8];
+
+	/**
+	 * Returns the number of bytes of this structure which must be stored.
+	 */
+	size_t size() const
+	{
+		const size_t n = count > 2 ? count - 2 : 0;
+		return HEADER_SIZE + (n * width + 7) / 8;
+	}
+
+	/**
+	 * Decompresses the timestamps stored in this block.
+	 *
+	 * @param out is an array with space for at least count values.
+	 * @return the number of timestamps written to out.
+	 */
+	size_t decode(uint32_t *out) const;
+};
+#pragma pack(pop)
+
+/**
+ * Streaming writer which collects timestamps and compresses them into
+ * blocks. Requires about 800 bytes of RAM and is intended for hosts or larger
+ * microcontrollers.
+ */
+class store_writer {
+private:
+	/**
+	 * Zigzag encoded delta-of-delta values of the current block.
+	 */
+	uint32_t m_values[store_block::BLOCK_SIZE - 2];
+
+	/**
+	 * Block currently being assembled.
+	 */
+	store_block m_block;
+
+	/**
+	 * Last completed block.
+	 */
+	store_block m_result;
+
+	/**
+	 * Last timestamp passed to push().
+	 */
+	uint32_t m_last_t = 0;
+
+	/**
+	 * Last delta between two timestamps.
+	 */
+	uint32_t m_last_delta = 0;
+
+	/**
+	 * Compresses the current block into m_result and starts a new block.
+	 */
+	void finish();
+
+public:
+	/**
+	 * Creates a writer with an empty block.
+	 */
+	store_writer();
+
+	/**
+	 * Appends a timestamp to the series.
+	 *
+	 * @param t is the timestamp, for example the extended timestamp of a
+	 * falling edge marking the beginning of a second. The decoder reports
+	 * these edges through decoder::get_last_second(); extend them using the
+	 * extended timestamp of the current sample, see the README.
+	 * @return true if a block has been completed. The block can be read using
+	 * get_block().
+	 */
+	bool push(uint32_t t);
+
+	/**
+	 * Completes the current block, even if it is not full.
+	 *
+	 * @return true if the block contained any timestamps and can be read
+	 * using get_block().
+	 */
+	bool flush();
+
+	/**
+	 * Returns the last completed block.
+	 */
+	const store_block &get_block() const { return m_result; }
+};
+}
+
+#endif /* DCF77_STORE_HPP */
@@ -0,0 +1,167 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dcf77_synth.hpp"
+
+namespace dcf77 {
+
+/******************************************************************************
+ * Function "encode_frame"                                                    *
+ ******************************************************************************/
+
+static constexpr uint32_t DAY = 86400;
+
+static uint8_t encode_bcd(uint8_t v) { return ((v / 10) << 4) | (v % 10); }
+
+static uint8_t even_parity(uint32_t x) { return __builtin_popcount(x) & 1; }
+
+static bool leap_year(uint8_t y) { return (y % 4) == 0; }
+
+static uint8_t month_days(uint8_t y, uint8_t m)
+{
+	static constexpr uint8_t DAYS[12] = {31, 28, 31, 30, 31, 30,
+	                                     31, 31, 30, 31, 30, 31};
+	return DAYS[m - 1] + ((m == 2 && leap_year(y)) ? 1 : 0);
+}
+
+/**
+ * Returns the number of days between 1970-01-01 and the first day of the
+ * given month. Valid for the years 2000 to 2099.
+ */
+static uint32_t days_before(uint8_t y, uint8_t m)
+{
+	uint32_t days = 10957UL + 365UL * y + (y + 3) / 4;
+	for (uint8_t i = 1; i < m; i++) {
+		days += month_days(y, i);
+	}
+	return days;
+}
+
+/**
+ * Returns the time at which summer time starts (m = 3) or ends (m = 10) in
+ * the given year: 01:00 UTC on the last Sunday of the month.
+ */
+static uint32_t dst_switch(uint8_t y, uint8_t m)
+{
+	// 1970-01-01 was a Thursday, i.e. (days + 4) % 7 is zero on Sundays
+	const uint32_t last = days_before(y, m) + month_days(y, m) - 1;
+	return (last - (last + 4) % 7) * DAY + 3600;
+}
+
+data encode_frame(uint32_t unix_time)
+{
+	// Determine the year, the switching times and the local time
+	const uint32_t utc_days = unix_time / DAY;
+	uint8_t y = (utc_days - 10957UL) / 366;
+	while (days_before(y + 1, 1) <= utc_days) {
+		y++;
+	}
+	const uint32_t dst_begin = dst_switch(y, 3), dst_end = dst_switch(y, 10);
+	const bool cest = unix_time >= dst_begin && unix_time < dst_end;
+	const uint32_t next = cest ? dst_end : dst_begin;
+	const bool announce = unix_time < next && next - unix_time <= 3600;
+	const uint32_t local = unix_time + (cest ? 7200 : 3600);
+
+	// Split the local time into its components
+	const uint32_t days = local / DAY;
+	const uint32_t secs = local % DAY;
+	while (days_before(y + 1, 1) <= days) {
+		y++;
+	}
+	uint8_t m = 1;
+	while (m < 12 && days_before(y, m + 1) <= days) {
+		m++;
+	}
+	const uint8_t day = days - days_before(y, m) + 1;
+	const uint8_t dow = (days + 3) % 7 + 1;
+
+	data res;
+	res.raw.dst_leap_hour = announce;
+	res.raw.cest = cest;
+	res.raw.cet = !cest;
+	res.raw.time_start = 1;
+	res.raw.minute = encode_bcd((secs / 60) % 60);
+	res.raw.parity_minute = even_parity(res.raw.minute);
+	res.raw.hour = encode_bcd(secs / 3600);
+	res.raw.parity_hour = even_parity(res.raw.hour);
+	res.raw.day = encode_bcd(day);
+	res.raw.day_of_week = dow;
+	res.raw.month = encode_bcd(m);
+	res.raw.year = encode_bcd(y);
+	res.raw.parity_date =
+	    even_parity(res.raw.day | (res.raw.day_of_week << 6) |
+	                (uint32_t(res.raw.month) << 9) |
+	                (uint32_t(res.raw.year) << 14));
+	return res;
+}
+
+/******************************************************************************
+ * Class "signal_generator"                                                   *
+ ******************************************************************************/
+
+static constexpr uint16_t MINUTE = 60000;
+
+signal_generator::signal_generator(uint32_t unix_time,
+                                   const synth_config &config, uint32_t seed)
+    : m_config(config), m_pos((MINUTE - config.phase % MINUTE) % MINUTE),
+      m_t(0), m_rng(seed ? seed : 1)
+{
+	// If the first minute mark is at timestamp zero, the generator starts
+	// with the frame following it
+	m_unix_time = m_pos == 0 ? unix_time + 60 : unix_time;
+	m_frame = encode_frame(m_unix_time);
+}
+
+void signal_generator::next_minute()
+{
+	m_pos = 0;
+	m_unix_time += 60;
+	m_frame = encode_frame(m_unix_time);
+}
+
+bool signal_generator::sample()
+{
+	// The carrier is lowered for 100 or 200 ms at the beginning of each
+	// second except for the last one
+	const uint8_t sec = m_pos / 1000;
+	const uint16_t ms = m_pos % 1000;
+	bool value = true;
+	if (sec < 59) {
+		value = ms >= (((m_frame.bitstream >> sec) & 1) ? 200 : 100);
+	}
+
+	// Start dropouts at the beginning of a second, flip random samples
+	if (ms == 0 && m_config.dropout_rate > 0 &&
+	    (random() & 0xFFFF) < m_config.dropout_rate) {
+		m_dropout = m_config.dropout_length;
+	}
+	if (m_dropout > 0) {
+		value = false;
+		m_dropout--;
+	}
+	if (m_config.noise > 0 && (random() & 0xFFFF) < m_config.noise) {
+		value = !value;
+	}
+
+	m_t++;
+	if (++m_pos == MINUTE) {
+		next_minute();
+	}
+	return value != m_config.inverted;
+}
+}
@@ -0,0 +1,181 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dcf77_synth.hpp
+ *
+ * Synthetic receiver output for testing and capacity planning. Each
+ * signal_generator produces the demodulated output of one receiver,
+ * including a phase offset, random noise, an inverted output and dropouts.
+ * Many independent generators can drive an array of decoders to measure how
+ * many channels a host sustains in real time.
+ *
+ * @author Andreas Stöckel
+ */
+
+#ifndef DCF77_SYNTH_HPP
+#define DCF77_SYNTH_HPP
+
+#include "dcf77.hpp"
+
+namespace dcf77 {
+
+/**
+ * Encodes the frame transmitted during the minute before the given time,
+ * i.e. the frame describing the given time. Switches between CET and CEST
+ * according to the rules of the European Union, including the announcement
+ * bit. The auxiliary data bits are zero, no leap seconds are announced.
+ *
+ * @param unix_time is the time in seconds since 1970-01-01 00:00:00 UTC.
+ * Must be a multiple of 60 in the years 2000 to 2099.
+ */
+data encode_frame(uint32_t unix_time);
+
+/**
+ * Parameters of a signal_generator.
+ */
+struct synth_config {
+	/**
+	 * Timestamp of the first minute mark in milliseconds, modulo one minute.
+	 */
+	uint16_t phase = 0;
+
+	/**
+	 * Probability of inverting a single sample, in units of 1/65536.
+	 */
+	uint16_t noise = 0;
+
+	/**
+	 * If true, the output is one while the carrier is lowered, as is the case
+	 * for many receiver modules.
+	 */
+	bool inverted = false;
+
+	/**
+	 * Probability of a dropout starting in any given second, in units of
+	 * 1/65536. The carrier is lowered during a dropout.
+	 */
+	uint16_t dropout_rate = 0;
+
+	/**
+	 * Length of a dropout in milliseconds.
+	 */
+	uint16_t dropout_length = 0;
+};
+
+/**
+ * Generates the output of a single receiver, one sample per millisecond.
+ */
+class signal_generator {
+private:
+	/**
+	 * Generator parameters.
+	 */
+	synth_config m_config;
+
+	/**
+	 * Frame transmitted during the current minute.
+	 */
+	data m_frame;
+
+	/**
+	 * Time described by m_frame.
+	 */
+	uint32_t m_unix_time;
+
+	/**
+	 * Position within the current minute in milliseconds.
+	 */
+	uint16_t m_pos;
+
+	/**
+	 * Timestamp of the next sample.
+	 */
+	uint16_t m_t;
+
+	/**
+	 * Remaining length of the current dropout in milliseconds.
+	 */
+	uint16_t m_dropout = 0;
+
+	/**
+	 * State of the xorshift random number generator, never zero.
+	 */
+	uint32_t m_rng;
+
+	/**
+	 * Advances the random number generator.
+	 */
+	uint32_t random()
+	{
+		m_rng ^= m_rng << 13;
+		m_rng ^= m_rng >> 17;
+		m_rng ^= m_rng << 5;
+		return m_rng;
+	}
+
+	/**
+	 * Moves on to the next minute.
+	 */
+	void next_minute();
+
+public:
+	/**
+	 * Creates a new generator.
+	 *
+	 * @param unix_time is the time of the minute mark at timestamp
+	 * config.phase, see encode_frame().
+	 * @param config contains the signal parameters.
+	 * @param seed initialises the random number generator. Generators with
+	 * different seeds produce independent noise.
+	 */
+	signal_generator(uint32_t unix_time, const synth_config &config,
+	                 uint32_t seed = 1);
+
+	/**
+	 * Returns the timestamp of the next sample.
+	 */
+	uint16_t time() const { return m_t; }
+
+	/**
+	 * Returns the time described by the frame currently being transmitted,
+	 * i.e. the time of the next minute mark.
+	 */
+	uint32_t unix_time() const { return m_unix_time; }
+
+	/**
+	 * Generates the next sample and advances the time by one millisecond.
+	 */
+	bool sample();
+
+	/**
+	 * Generates n consecutive samples.
+	 *
+	 * @param out receives the samples.
+	 * @param n is the number of samples.
+	 */
+	void generate(bool *out, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) {
+			out[i] = sample();
+		}
+	}
+};
+}
+
+#endif /* DCF77_SYNTH_HPP */
@@ -0,0 +1,240 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dcf77_telemetry.hpp"
+
+namespace dcf77 {
+
+/******************************************************************************
+ * Helper functions                                                           *
+ ******************************************************************************/
+
+static uint16_t crc16(const uint8_t *buf, uint8_t len)
+{
+	uint16_t crc = 0xFFFF;
+	for (uint8_t i = 0; i < len; i++) {
+		crc ^= uint16_t(buf[i]) << 8;
+		for (uint8_t j = 0; j < 8; j++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+static uint8_t *write_u16(uint8_t *p, uint16_t x)
+{
+	*(p++) = x & 0xFF;
+	*(p++) = x >> 8;
+	return p;
+}
+
+static uint16_t read_u16(const uint8_t *p)
+{
+	return p[0] | (uint16_t(p[1]) << 8);
+}
+
+/******************************************************************************
+ * Class "telemetry_encoder"                                                  *
+ ******************************************************************************/
+
+/**
+ * Maximum size of a message before COBS encoding.
+ */
+static constexpr uint8_t RAW_SIZE = telemetry_encoder::MAX_SIZE - 2;
+
+uint8_t telemetry_encoder::finish(uint8_t *raw, uint8_t len)
+{
+	// Append the CRC
+	write_u16(raw + len, crc16(raw, len));
+	len += 2;
+
+	// Apply COBS. Messages are shorter than 254 bytes, so there is no need
+	// to split them into blocks.
+	uint8_t code_idx = 0, out = 1, code = 1;
+	for (uint8_t i = 0; i < len; i++) {
+		if (raw[i] == 0) {
+			m_buf[code_idx] = code;
+			code_idx = out++;
+			code = 1;
+		} else {
+			m_buf[out++] = raw[i];
+			code++;
+		}
+	}
+	m_buf[code_idx] = code;
+	m_buf[out++] = 0;
+	return out;
+}
+
+uint8_t telemetry_encoder::encode_frame(const decoder &dec, decoder::state s)
+{
+	uint8_t raw[RAW_SIZE];
+	uint8_t *p = raw;
+	*(p++) = uint8_t(telemetry_type::frame);
+	*(p++) = m_channel;
+	*(p++) = uint8_t(s);
+	*(p++) = dec.get_validity();
+	p = write_u16(p, dec.get_phase());
+	uint64_t bitstream = dec.get_data().bitstream;
+	for (uint8_t i = 0; i < 8; i++) {
+		*(p++) = bitstream & 0xFF;
+		bitstream >>= 8;
+	}
+	return finish(raw, p - raw);
+}
+
+uint8_t telemetry_encoder::encode_state(decoder::state s, uint16_t t)
+{
+	uint8_t raw[RAW_SIZE];
+	uint8_t *p = raw;
+	*(p++) = uint8_t(telemetry_type::state);
+	*(p++) = m_channel;
+	*(p++) = uint8_t(s);
+	p = write_u16(p, t);
+	return finish(raw, p - raw);
+}
+
+uint8_t telemetry_encoder::encode_second(uint8_t second, bool bit, uint16_t t)
+{
+	uint8_t raw[RAW_SIZE];
+	uint8_t *p = raw;
+	*(p++) = uint8_t(telemetry_type::second);
+	*(p++) = m_channel;
+	*(p++) = (second & 0x3F) | (bit ? 0x80 : 0x00);
+	p = write_u16(p, t);
+	return finish(raw, p - raw);
+}
+
+uint8_t telemetry_encoder::encode_quality(const debounce::quality &q)
+{
+	uint8_t raw[RAW_SIZE];
+	uint8_t *p = raw;
+	*(p++) = uint8_t(telemetry_type::quality);
+	*(p++) = m_channel;
+	p = write_u16(p, q.transition_time);
+	*(p++) = q.glitches;
+	*(p++) = q.plateau_variance;
+	*(p++) = q.value;
+	return finish(raw, p - raw);
+}
+
+/******************************************************************************
+ * Class "telemetry_decoder"                                                  *
+ ******************************************************************************/
+
+bool telemetry_decoder::push(uint8_t byte)
+{
+	if (byte != 0) {
+		if (m_len < MAX_SIZE) {
+			m_buf[m_len++] = byte;
+		} else {
+			m_overflow = true;
+		}
+		return false;
+	}
+
+	// A zero byte terminates the message
+	bool res = false;
+	if (m_len > 0) {
+		res = !m_overflow && decode();
+		if (!res) {
+			m_errors++;
+		}
+	}
+	m_len = 0;
+	m_overflow = false;
+	return res;
+}
+
+bool telemetry_decoder::decode()
+{
+	// Undo the COBS encoding in place
+	uint8_t len = 0;
+	for (uint8_t i = 0; i < m_len;) {
+		const uint8_t code = m_buf[i++];
+		if (i + code - 1 > m_len) {
+			return false;
+		}
+		for (uint8_t j = 1; j < code; j++) {
+			m_buf[len++] = m_buf[i++];
+		}
+		if (code < 0xFF && i < m_len) {
+			m_buf[len++] = 0;
+		}
+	}
+
+	// Check the CRC
+	if (len < 4) {
+		return false;
+	}
+	len -= 2;
+	if (read_u16(m_buf + len) != crc16(m_buf, len)) {
+		return false;
+	}
+
+	// Parse the payload
+	const uint8_t *p = m_buf + 2;
+	const uint8_t payload_len = len - 2;
+	// Parse into a copy, so m_message is only modified on success
+	telemetry_message msg = m_message;
+	msg.type = telemetry_type(m_buf[0]);
+	msg.channel = m_buf[1];
+	switch (msg.type) {
+		case telemetry_type::frame:
+			if (payload_len != 12) {
+				return false;
+			}
+			msg.state = decoder::state(int8_t(p[0]));
+			msg.validity = p[1];
+			msg.t = read_u16(p + 2);
+			msg.frame.bitstream = 0;
+			for (uint8_t i = 0; i < 8; i++) {
+				msg.frame.bitstream |= uint64_t(p[4 + i]) << (8 * i);
+			}
+			break;
+		case telemetry_type::state:
+			if (payload_len != 3) {
+				return false;
+			}
+			msg.state = decoder::state(int8_t(p[0]));
+			msg.t = read_u16(p + 1);
+			break;
+		case telemetry_type::second:
+			if (payload_len != 3) {
+				return false;
+			}
+			msg.second = p[0] & 0x3F;
+			msg.bit = p[0] & 0x80;
+			msg.t = read_u16(p + 1);
+			break;
+		case telemetry_type::quality:
+			if (payload_len != 5) {
+				return false;
+			}
+			msg.quality.transition_time = read_u16(p);
+			msg.quality.glitches = p[2];
+			msg.quality.plateau_variance = p[3];
+			msg.quality.value = p[4];
+			break;
+		default:
+			return false;
+	}
+	m_message = msg;
+	return true;
+}
+}
@@ -0,0 +1,284 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dcf77_telemetry.hpp
+ *
+ * Compact binary protocol for transmitting decoder results and diagnostics
+ * from a microcontroller to a host over a slow serial link. Each message
+ * consists of a type byte, a channel byte, the payload and a CRC-16
+ * (CCITT, polynomial 0x1021, initial value 0xFFFF). The message is framed
+ * using Consistent Overhead Byte Stuffing (COBS) and terminated by a zero
+ * byte. All multi-byte values are transmitted in little-endian byte order.
+ *
+ * @author Andreas Stöckel
+ */
+
+#ifndef DCF77_TELEMETRY_HPP
+#define DCF77_TELEMETRY_HPP
+
+#include "dcf77.hpp"
+
+namespace dcf77 {
+
+/**
+ * Enum describing the message types of the telemetry protocol.
+ */
+enum class telemetry_type : uint8_t {
+	/**
+	 * A frame returned by the decoder. Payload: decoder state (1 byte),
+	 * validity flags (1 byte), phase (2 bytes), bitstream (8 bytes).
+	 */
+	frame = 1,
+
+	/**
+	 * A change of the decoder state. Payload: decoder state (1 byte),
+	 * timestamp (2 bytes).
+	 */
+	state = 2,
+
+	/**
+	 * A single received bit. Payload: second (bits 0-5) and bit value (bit 7)
+	 * (1 byte), timestamp of the falling edge (2 bytes).
+	 */
+	second = 3,
+
+	/**
+	 * Signal quality counters. Payload: transition time (2 bytes), glitches
+	 * (1 byte), plateau variance (1 byte), quality value (1 byte).
+	 */
+	quality = 4
+};
+
+/**
+ * Structure holding a message decoded by the telemetry_decoder class. Only
+ * the members corresponding to the message type are valid.
+ */
+struct telemetry_message {
+	/**
+	 * Type of the message.
+	 */
+	telemetry_type type;
+
+	/**
+	 * Channel the message originates from.
+	 */
+	uint8_t channel;
+
+	/**
+	 * Decoder state for frame and state messages.
+	 */
+	decoder::state state;
+
+	/**
+	 * Validity flags for frame messages.
+	 */
+	uint8_t validity;
+
+	/**
+	 * Phase for frame messages, timestamp for state and second messages.
+	 */
+	uint16_t t;
+
+	/**
+	 * Received data for frame messages.
+	 */
+	data frame;
+
+	/**
+	 * Second within the minute for second messages, 63 if unknown.
+	 */
+	uint8_t second;
+
+	/**
+	 * Bit value for second messages.
+	 */
+	bool bit;
+
+	/**
+	 * Signal quality for quality messages.
+	 */
+	debounce::quality quality;
+
+	telemetry_message()
+	    : type(telemetry_type::frame), channel(0),
+	      state(decoder::state::no_result), validity(0), t(0), second(0),
+	      bit(false)
+	{
+	}
+};
+
+/**
+ * Encodes telemetry messages into an internal buffer. The encoder does not
+ * allocate memory and only requires MAX_SIZE bytes of RAM for the buffer.
+ */
+class telemetry_encoder {
+public:
+	/**
+	 * Maximum size of an encoded message, including the COBS overhead and the
+	 * terminating zero byte.
+	 */
+	static constexpr uint8_t MAX_SIZE = 20;
+
+private:
+	/**
+	 * Buffer holding the last encoded message.
+	 */
+	uint8_t m_buf[MAX_SIZE];
+
+	/**
+	 * Channel identifier added to each message.
+	 */
+	uint8_t m_channel;
+
+	/**
+	 * Adds the CRC to the message of the given length stored in the raw
+	 * buffer, applies COBS and writes the result to m_buf.
+	 *
+	 * @return the length of the encoded message.
+	 */
+	uint8_t finish(uint8_t *raw, uint8_t len);
+
+public:
+	/**
+	 * Creates a new encoder.
+	 *
+	 * @param channel is an identifier added to each message, for example the
+	 * address of the node on an RS-485 bus.
+	 */
+	telemetry_encoder(uint8_t channel = 0) : m_channel(channel) {}
+
+	/**
+	 * Encodes the data, validity flags and phase of the given decoder.
+	 *
+	 * @param dec is the decoder from which the data should be read.
+	 * @param s is the state returned by the last call to decoder::sample().
+	 * @return the length of the encoded message.
+	 */
+	uint8_t encode_frame(const decoder &dec, decoder::state s);
+
+	/**
+	 * Encodes a change of the decoder state.
+	 *
+	 * @return the length of the encoded message.
+	 */
+	uint8_t encode_state(decoder::state s, uint16_t t);
+
+	/**
+	 * Encodes a single received bit.
+	 *
+	 * @param second is the second within the minute (0 to 59).
+	 * @param bit is the received bit.
+	 * @param t is the timestamp of the falling edge starting the second.
+	 * @return the length of the encoded message.
+	 */
+	uint8_t encode_second(uint8_t second, bool bit, uint16_t t);
+
+	/**
+	 * Encodes the second returned by decoder::get_last_second(). Seconds
+	 * received while the decoder is not synchronised are encoded as second
+	 * 63.
+	 *
+	 * @return the length of the encoded message.
+	 */
+	uint8_t encode_second(const decoder::second_info &s)
+	{
+		return encode_second(s.second < 60 ? s.second : 63, s.bit, s.t);
+	}
+
+	/**
+	 * Encodes the given signal quality counters.
+	 *
+	 * @return the length of the encoded message.
+	 */
+	uint8_t encode_quality(const debounce::quality &q);
+
+	/**
+	 * Returns a pointer at the last encoded message.
+	 */
+	const uint8_t *buffer() const { return m_buf; }
+};
+
+/**
+ * Streaming decoder for the telemetry protocol. Bytes received from the link
+ * are passed to the push() method one by one. Corrupted messages are
+ * discarded, the decoder resynchronises at the next zero byte.
+ */
+class telemetry_decoder {
+public:
+	/**
+	 * Maximum size of a received message without the terminating zero byte.
+	 */
+	static constexpr uint8_t MAX_SIZE = telemetry_encoder::MAX_SIZE - 1;
+
+private:
+	/**
+	 * Buffer holding the bytes received since the last zero byte.
+	 */
+	uint8_t m_buf[MAX_SIZE];
+
+	/**
+	 * Number of bytes in m_buf.
+	 */
+	uint8_t m_len = 0;
+
+	/**
+	 * Set if the current message exceeds the buffer size.
+	 */
+	bool m_overflow = false;
+
+	/**
+	 * Number of discarded messages.
+	 */
+	uint16_t m_errors = 0;
+
+	/**
+	 * Last successfully decoded message.
+	 */
+	telemetry_message m_message;
+
+	/**
+	 * Decodes the message in m_buf.
+	 *
+	 * @return true if the message is valid.
+	 */
+	bool decode();
+
+public:
+	/**
+	 * Processes a single byte received from the link.
+	 *
+	 * @return true if a complete and valid message was received. The message
+	 * can be read using the get_message() method.
+	 */
+	bool push(uint8_t byte);
+
+	/**
+	 * Returns the last successfully decoded message.
+	 */
+	const telemetry_message &get_message() const { return m_message; }
+
+	/**
+	 * Returns the number of messages discarded because of framing, length or
+	 * CRC errors.
+	 */
+	uint16_t get_errors() const { return m_errors; }
+};
+}
+
+#endif /* DCF77_TELEMETRY_HPP */
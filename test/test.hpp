@@ -0,0 +1,100 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file test.hpp
+ *
+ * Minimal assertion helpers shared by the host tests. Each test is a separate
+ * program which returns a non-zero exit code if any check failed.
+ *
+ * @author Andreas Stöckel
+ */
+
+#ifndef DCF77_TEST_HPP
+#define DCF77_TEST_HPP
+
+#include <stdio.h>
+
+#include "../dcf77_synth.hpp"
+
+namespace dcf77 {
+namespace test {
+
+/**
+ * Number of failed checks.
+ */
+static int failures = 0;
+
+/**
+ * Records the result of a check and reports failures on stderr.
+ */
+static inline bool check(bool ok, const char *expr, const char *file,
+                         int line)
+{
+	if (!ok) {
+		fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+		failures++;
+	}
+	return ok;
+}
+
+/**
+ * Runs a test function and reports its name if it failed.
+ */
+static inline void run(void (*fn)(), const char *name)
+{
+	const int n = failures;
+	fn();
+	if (failures != n) {
+		fprintf(stderr, "FAILED %s\n", name);
+	}
+}
+
+/**
+ * Returns the exit code of the test program.
+ */
+static inline int result()
+{
+	if (failures > 0) {
+		fprintf(stderr, "%d check(s) failed\n", failures);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Feeds the samples of a generator into a decoder until the given number of
+ * minutes has been transmitted. Calls fn(decoder, result, generator) after
+ * each sample.
+ */
+template <typename F>
+void feed(decoder &dec, signal_generator &gen, uint16_t minutes, F &&fn)
+{
+	for (uint32_t i = 0; i < uint32_t(minutes) * 60000; i++) {
+		const uint16_t t = gen.time();
+		const bool value = gen.sample();
+		fn(dec, dec.sample(value, t), gen);
+	}
+}
+}
+}
+
+#define CHECK(expr) dcf77::test::check((expr), #expr, __FILE__, __LINE__)
+#define RUN(fn) dcf77::test::run(fn, #fn)
+
+#endif /* DCF77_TEST_HPP */
@@ -0,0 +1,144 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../dcf77_backfill.hpp"
+#include "test.hpp"
+
+using namespace dcf77;
+
+/**
+ * 2024-10-01 12:00:00 UTC, 14:00 CEST.
+ */
+static constexpr uint32_t START = 1727784000UL;
+
+/**
+ * Event recorded by a test, together with the time at which it occurred.
+ */
+struct expected_event {
+	uint32_t sample;
+	uint16_t tag;
+};
+
+/**
+ * Feeds a generator into a decoder and a backfill instance, recording the
+ * given events at the given sample indices, and checks the resolved times.
+ *
+ * @param delay is the number of samples by which recording an event lags
+ * behind the sample it refers to.
+ */
+static void run_backfill(const synth_config &cfg, const expected_event *events,
+                         size_t n_events, uint16_t delay = 0)
+{
+	backfill::event buf[8];
+	backfill bf(buf, 8);
+	signal_generator gen(START, cfg);
+	decoder dec;
+	backfill::resolved out[8];
+	size_t n_out = 0;
+	size_t next = 0;
+	for (uint32_t i = 0; i < 180000; i++) {
+		// Resolve the pending events as soon as a reference is available
+		const uint16_t t = gen.time();
+		const decoder::state res = dec.sample(gen.sample(), t);
+		if (bf.anchor(dec, res, t)) {
+			n_out += bf.resolve(out + n_out, 8 - n_out);
+		}
+		if (next < n_events && events[next].sample + delay == i) {
+			CHECK(bf.record(events[next].tag, t - delay));
+			next++;
+		}
+	}
+	CHECK(next == n_events);
+	CHECK(bf.pending() == 0);
+
+	// The minute mark at timestamp cfg.phase is START
+	CHECK(n_out == n_events);
+	for (size_t i = 0; i < n_out; i++) {
+		const int64_t ms = int64_t(START) * 1000 + events[i].sample -
+		                   cfg.phase;
+		CHECK(out[i].tag == events[i].tag);
+		CHECK(out[i].unix_time == uint32_t(ms / 1000));
+		CHECK(out[i].ms == uint16_t(ms % 1000));
+	}
+}
+
+static void test_order()
+{
+	// Events before the first minute mark, before and after the first
+	// wrap-around of the timestamp and after the first valid frame
+	static const expected_event events[] = {
+	    {500, 1}, {1233, 2}, {40000, 3}, {65535, 4}, {65537, 5}, {120001, 6}};
+	synth_config cfg;
+	cfg.phase = 1234;
+	run_backfill(cfg, events, 6);
+}
+
+static void test_late_record()
+{
+	// Events captured in an interrupt and recorded after the main loop has
+	// already passed later timestamps to anchor()
+	static const expected_event events[] = {
+	    {500, 1}, {1233, 2}, {40000, 3}, {65535, 4}, {70000, 5}, {120001, 6}};
+	synth_config cfg;
+	cfg.phase = 1234;
+	run_backfill(cfg, events, 6, 5);
+}
+
+static void test_partial_frame()
+{
+	// The first frame is received from second 20 on, so its time and date
+	// are valid but the CEST flag is not. Anchoring on it would resolve all
+	// events one hour off.
+	static const expected_event events[] = {{500, 1}, {19999, 2}};
+	synth_config cfg;
+	cfg.phase = 40000;
+	run_backfill(cfg, events, 2);
+}
+
+static void test_unanchored()
+{
+	backfill::event buf[4];
+	backfill bf(buf, 4);
+	decoder dec;
+	backfill::resolved out[4];
+	CHECK(bf.record(1, 100));
+	CHECK(!bf.anchor(dec, decoder::state::no_result, 200));
+	CHECK(bf.resolve(out, 4) == 0);
+	CHECK(bf.pending() == 1);
+}
+
+static void test_overflow()
+{
+	backfill::event buf[2];
+	backfill bf(buf, 2);
+	CHECK(bf.record(1, 100));
+	CHECK(bf.record(2, 200));
+	CHECK(!bf.record(3, 300));
+	CHECK(bf.pending() == 2);
+	CHECK(bf.get_overflows() == 1);
+}
+
+int main()
+{
+	RUN(test_order);
+	RUN(test_late_record);
+	RUN(test_partial_frame);
+	RUN(test_unanchored);
+	RUN(test_overflow);
+	return test::result();
+}
@@ -0,0 +1,217 @@
+/**
+ *  libdcf77 -- Cross Platform C++ DCF77 decoder
+ *  Copyright (C) 2016  Andreas Stöckel
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test.hpp"
+
+using namespace dcf77;
+
+/**
+ * 2024-10-01 12:00:00 UTC, 14:00 CEST.
+ */
+static constexpr uint32_t START = 1727784000UL;
+
+/**
+ * Counts the frames published by a decoder and compares them with the time
+ * transmitted by the generator.
+ */
+struct frame_stats {
+	uint16_t tolerance = 0;
+	uint16_t mark = 0;
+	uint32_t mark_time = 0;
+	uint16_t n_complete = 0;
+	uint16_t n_time = 0;
+	uint16_t n_wrong = 0;
+
+	void operator()(decoder &dec, decoder::state res,
+	                const signal_generator &gen)
+	{
+		// Remember the timestamp of the last minute mark
+		if (gen.unix_time() != mark_time + 60) {
+			mark = gen.time();
+			mark_time = gen.unix_time() - 60;
+		}
+		if (res >= decoder::state::has_time_and_date) {
+			// The UTC offset is only known if the flags were received
+			const data expected = encode_frame(mark_time);
+			const data &d = dec.get_data();
+			const int16_t dt = dec.get_phase() - mark;
+			bool ok = d.minute() == expected.minute() &&
+			          d.hour() == expected.hour() &&
+			          d.day() == expected.day() &&
+			          d.month() == expected.month() &&
+			          d.year() == expected.year() && dt <= tolerance &&
+			          -dt <= tolerance;
+			if (dec.get_validity() & data::VALID_FLAGS) {
+				ok = ok && d.unix_time() == mark_time;
+			}
+			n_wrong += ok ? 0 : 1;
+			n_time++;
+			n_complete += res == decoder::state::has_complete ? 1 : 0;
+		}
+	}
+};
+
+/**
+ * Feeds a signal into a decoder which is interrupted from 23:58:50 to
+ * 23:59:10 local time. After the interruption, all synchronisation gaps
+ * contain a glitch, so the decoder must find the start of the minute from the
+ * frame structure. The frames received then carry the date of the next day.
+ *
+ * @param corrupt_date if true, the date parity is inverted in all frames
+ * before the interruption, so that only the time of day was published.
+ */
+static void run_sync_loss(bool corrupt_date)
+{
+	// 2024-10-01 23:50:00 CEST
+	static constexpr uint32_t night = 1727819400UL;
+	static constexpr uint32_t phase = 1234;
+	static constexpr uint32_t loss = phase + 530000;
+	synth_config cfg;
+	cfg.phase = phase;
+	signal_generator gen(night, cfg);
+	decoder dec;
+	frame_stats stats;
+	uint16_t n_before = 0, n_next_day = 0;
+	for (uint32_t i = 0; i < 20 * 60000UL; i++) {
+		const uint16_t t = gen.time();
+		bool value = gen.sample();
+		const uint32_t pos = (i + 60000 - phase) % 60000;
+		if (i >= loss && pos >= 59500 && pos < 59600) {
+			value = false;
+		}
+		if (corrupt_date && i < loss && pos >= 58100 && pos < 58200) {
+			value = !value;
+		}
+		if (i >= loss && i < loss + 20000) {
+			continue;
+		}
+		const decoder::state res = dec.sample(value, t);
+		stats(dec, res, gen);
+		if (res >= decoder::state::has_time) {
+			if (i < loss) {
+				n_before++;
+			} else if (res >= decoder::state::has_time_and_date &&
+			           dec.get_data().day() == 2) {
+				n_next_day++;
+			}
+		}
+	}
+	CHECK(stats.n_wrong == 0);
+	CHECK(n_before >= 6);
+	CHECK(n_next_day >= 8);
+	CHECK(dec.get_data().day() == 2 && dec.get_data().hour() == 0);
+}
+
+static void test_clean()
+{
+	synth_config cfg;
+	cfg.phase = 1234;
+	signal_generator gen(START, cfg);
+	decoder dec;
+	frame_stats stats;
+	test::feed(dec, gen, 10, stats);
+
+	// The first minute is incomplete, all others are received completely
+	CHECK(stats.n_wrong == 0);
+	CHECK(stats.n_complete == 9);
+	CHECK(dec.get_validity() == data::VALID_ALL);
+	CHECK(dec.get_data().hour() == 14 && dec.get_data().minute() == 9);
+	CHECK(dec.get_data().daylight_saving());
+	CHECK(dec.get_quality().value == 0xFF);
+	CHECK(dec.get_quality().glitches == 0);
+}
+
+static void test_noisy()
+{
+	synth_config cfg;
+	cfg.phase = 20000;
+	cfg.noise = 655; // 1%
+	signal_generator gen(START, cfg, 7);
+	decoder dec;
+	frame_stats stats;
+	stats.tolerance = 50;
+	test::feed(dec, gen, 30, stats);
+
+	// The filter removes most of the noise, wrong times are never published
+	CHECK(stats.n_wrong == 0);
+	CHECK(stats.n_complete >= 25);
+	CHECK(dec.get_quality().value < 0xFF);
+}
+
+static void test_dropouts()
+{
+	synth_config cfg;
+	cfg.phase = 40000;
+	cfg.noise = 66; // 0.1%
+	cfg.dropout_rate = 1311; // 2% of all seconds
+	cfg.dropout_length = 300;
+	signal_generator gen(START, cfg, 3);
+	decoder dec;
+	frame_stats stats;
+	stats.tolerance = 50;
+	test::feed(dec, gen, 30, stats);
+
+	// Minutes with a dropout are lost, the others are still decoded
+	CHECK(stats.n_wrong == 0);
+	CHECK(stats.n_time >= 15);
+}
+
+#ifdef DCF77_FRAME_CACHE
+static void test_frame_cache()
+{
+	// Two receivers of the same signal, one of them noisy
+	synth_config cfg;
+	cfg.phase = 1234;
+	signal_generator gen_a(START, cfg);
+	cfg.noise = 655;
+	signal_generator gen_b(START, cfg, 5);
+	frame_cache cache;
+	decoder dec_a, dec_b;
+	dec_a.set_frame_cache(&cache);
+	dec_b.set_frame_cache(&cache);
+	frame_stats stats_a, stats_b;
+	stats_b.tolerance = 50;
+	for (uint32_t i = 0; i < 10 * 60000UL; i++) {
+		const uint16_t t = gen_a.time();
+		stats_a(dec_a, dec_a.sample(gen_a.sample(), t), gen_a);
+		stats_b(dec_b, dec_b.sample(gen_b.sample(), t), gen_b);
+	}
+	CHECK(stats_a.n_wrong == 0 && stats_b.n_wrong == 0);
+	CHECK(stats_a.n_complete == 9);
+	CHECK(dec_a.get_bits_checked() > 0);
+	CHECK(dec_a.get_bit_errors() == 0);
+	CHECK(dec_b.get_bits_checked() > 0);
+}
+#endif
+
+static void test_sync_loss_at_midnight() { run_sync_loss(false); }
+
+static void test_sync_loss_time_only() { run_sync_loss(true); }
+
+int main()
+{
+	RUN(test_clean);
+	RUN(test_noisy);
+	RUN(test_dropouts);
+#ifdef DCF77_FRAME_CACHE
+	RUN(test_frame_cache);
+#endif
+	RUN(test_sync_loss_at_midnight);
+	RUN(test_sync_loss_time_only);
+	return test::result();
+}